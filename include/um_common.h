@@ -43,12 +43,20 @@
 #include <sys/un.h>
 
 #define SOCK_PATH "/tmp/usb_server_sock"
+#define SOCK_PATH_BIN "/tmp/usb_server_sock_bin"
 #define ACC_SOCK_PATH "/tmp/usb_acc_sock"
+#ifndef IPC_LISTEN_BACKLOG
+#define IPC_LISTEN_BACKLOG 64 /* Can be set at build time */
+#endif
+#ifndef USB_STATUS_SETTLE_MS
+#define USB_STATUS_SETTLE_MS 300 /* Can be set at build time */
+#endif
+#define VCONFKEY_USB_CONFIGURED_TIME "memory/usb/configured_time" /* ms, -1 if not configured or not known */
 #define USB_ACCESSORY_NODE "/dev/usb_accessory"
+#define USB_ACCESSORY_DEVPATH "/devices/virtual/misc/usb_accessory"
 #define SETTING_USB_ACCESSORY_MODE 5
 #define SOCK_STR_LEN 1542 /* 6 elements + 5 separators + 1 NULL terminator
 							= 256 * 6 + 5 * 1 + 1 = 1542 */
-#define ACC_INFO_NUM 6
 #define SETTING_USB_DEFAULT_MODE 0
 
 
@@ -111,6 +119,7 @@ int check_storage_connection();
 int launch_usb_syspopup(UmMainData *ad, POPUP_TYPE _popup_type);
 void load_system_popup(UmMainData *ad, POPUP_TYPE _popup_type);
 
+int ipc_server_socket_init(const char *path, int type);
 int ipc_request_server_init();
 int ipc_request_server_close(UmMainData *ad);
 int ipc_noti_server_init();
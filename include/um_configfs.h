@@ -0,0 +1,77 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_CONFIGFS_H__
+#define __UM_CONFIGFS_H__
+
+#include "um_common.h"
+
+#ifndef USB_CONFIGFS_ROOT
+#define USB_CONFIGFS_ROOT		"/sys/kernel/config/usb_gadget"	/* Can be set at build time */
+#endif
+/* usb-server does not mount FunctionFS. The platform mounts each instance at
+ * USB_FFS_ROOT/<instance> once the gadget exists, before its daemon starts,
+ * e.g. mount -t functionfs sdb /dev/usb-ffs/sdb */
+#ifndef USB_FFS_ROOT
+#define USB_FFS_ROOT			"/dev/usb-ffs"	/* Can be set at build time */
+#endif
+#define CONFIGFS_GADGET_PREFIX	"usb-server."
+#define CONFIGFS_FFS_PREFIX		"ffs."
+#define CONFIGFS_FFS_POLL		0.1		/* Seconds between checks of FunctionFS descriptors */
+#define CONFIGFS_FFS_TIMEOUT	10.0	/* The gadget is bound without them after that */
+#define CONFIGFS_LANG			"0x409"
+#define CONFIGFS_CONFIG			"c.1"
+#define CONFIGFS_MAX_FUNCS		3
+#define CONFIGFS_PATH_LEN		256
+#define CONFIGFS_UDC_LEN		64
+
+/* One gadget per kernel mode, built once. Its functions are linked when it is bound.
+ * mtp.gs0 and accessory.gs2 are only provided by kernels with the Android gadget
+ * functions, um_configfs_init() fails without them */
+typedef struct _UmConfigfsGadget {
+	int				mode;
+	const char		*name;
+	const char		*idVendor;
+	const char		*idProduct;
+	const char		*bDeviceClass;
+	const char		*bDeviceSubClass;
+	const char		*bDeviceProtocol;
+	const char		*product;
+	const char		*funcs[CONFIGFS_MAX_FUNCS];	/* "<function>.<instance>", NULL terminated */
+} UmConfigfsGadget;
+
+/* Builds the gadgets under USB_CONFIGFS_ROOT. Gadgets left by a previous run are reused */
+int um_configfs_init();
+/* bound is EINA_FALSE if the gadget could not be bound */
+typedef void (*um_configfs_bound_cb)(UmMainData *ad, Eina_Bool bound);
+
+/* Binds the gadget of mode to the UDC, SETTING_USB_NONE_MODE only unbinds.
+ * A FunctionFS function cannot be bound before its daemon wrote the descriptors,
+ * and the daemon is only started after this. The bind is deferred until then,
+ * so the host enumerates the gadget once */
+int um_configfs_set(int mode);
+/* Whether the gadget set last waits for its FunctionFS daemons to be bound */
+Eina_Bool um_configfs_binding();
+/* cb is called once the deferred bind is done.
+ * Returns -1 if no bind is deferred, then cb is not called */
+int um_configfs_wait_bound(um_configfs_bound_cb cb, UmMainData *ad);
+
+#endif /* __UM_CONFIGFS_H__ */
@@ -25,6 +25,10 @@
 #include <string.h>
 #include <vconf.h>
 #include "um_common.h"
+#include "um_data_router.h"
+#include "um_configfs.h"
+#include "um_vconf_cache.h"
+#include "um_event_bus.h"
 
 #define CMD_DR_START \
 	"/usr/bin/start_dr.sh"
@@ -51,6 +55,8 @@
 #define USB_DEVICE_PROTOCOL \
 	"/sys/class/usb_mode/usb0/bDeviceProtocol"
 #define DRIVER_VERSION_BUF_LEN  64
+#define KERNEL_NODE_BUF_LEN     64
+#define KERNEL_NODE_RING_DEPTH  8	/* enable=0, six descriptors and enable=1 */
 #define FILE_PATH_BUF_SIZE      256
 #define KERNEL_SET_BUF_SIZE     3
 #define KERNEL_DEFAULT_MODE     0
@@ -66,13 +72,28 @@
 #define TICKERNOTI_SYSPOPUP \
 	"tickernoti-syspopup"
 
+typedef enum {
+	USB_NODE_ENABLE = 0,
+	USB_NODE_VENDOR_ID,
+	USB_NODE_PRODUCT_ID,
+	USB_NODE_FUNCTIONS,
+	USB_NODE_DEVICE_CLASS,
+	USB_NODE_DEVICE_SUBCLASS,
+	USB_NODE_DEVICE_PROTOCOL,
+	MAX_NUM_USB_NODE
+} USB_KERNEL_NODE;
+
 static int mode_set_driver_0_0(int mode);
-static int mode_set_driver_1_0(int mode);
+static int mode_set_driver_1_0(int mode, Eina_Bool enable);
 static Eina_Bool write_file(const char *filepath, char *content);
 
 int check_driver_version(UmMainData *ad);
+int kernel_node_cache_init();
+void kernel_node_cache_deinit();
 int mode_set_kernel(USB_DRIVER_VERSION version, int mode);
+int mode_stage_kernel(USB_DRIVER_VERSION version, int mode);
 void start_dr(UmMainData *ad);
+void stop_dr(UmMainData *ad);
 void load_connection_popup(UmMainData *ad);
 
 #endif
@@ -26,6 +26,7 @@
 #include <Ecore.h>
 #include <unistd.h>
 #define ACC_ELEMENT_LEN 256
+#define ACC_INFO_NUM 6
 #define PKG_NAME_LEN 64
 
 typedef enum {
@@ -60,6 +61,9 @@ typedef enum {
 	/* General */
 	ERROR_POPUP_OK_BTN = 0,
 	IS_EMUL_BIN,
+	/* Protocol addition: IPC_SUCCESS while a mode change runs, is queued or
+	 * waits for the host. Servers without it answer IPC_ERROR */
+	IS_IN_MODE_CHANGE = 2,
 
 	/* for Accessory */
 	LAUNCH_APP_FOR_ACC = 20,
@@ -78,6 +82,7 @@ typedef enum {
 typedef enum {
 	USB_DRIVER_0_0 = 0,
 	USB_DRIVER_1_0,
+	USB_DRIVER_CONFIGFS,
 	MAX_NUM_USB_DRIVER_VERSION
 	/* We can add kernel versions here */
 } USB_DRIVER_VERSION;
@@ -96,6 +101,8 @@ typedef enum {
 	ACC_SERIAL
 } ACC_ELEMENT;
 
+/* The strings point into arena, which is reused for every accessory.
+ * Each element takes at most ACC_ELEMENT_LEN bytes with its NUL terminator */
 typedef struct _UsbAccessory {
 	char *manufacturer;
 	char *model;
@@ -103,24 +110,146 @@ typedef struct _UsbAccessory {
 	char *version;
 	char *uri;
 	char *serial;
+	int len[ACC_INFO_NUM];				/* Indexed by ACC_ELEMENT, without the NUL terminator */
+	int arenaUsed;
+	char arena[ACC_INFO_NUM * ACC_ELEMENT_LEN];
 } UsbAccessory;
 
+/* Accessory information serialized once per connection and shared read only.
+ * text is "manufacturer|model|description|version|uri|serial" with a NUL terminator,
+ * fields[] point to NUL terminated copies of each element */
+typedef struct _UmAccInfoBlob {
+	int						refCount;
+	unsigned int			generation;
+	int						textLen;		/* Without the NUL terminator */
+	char					*text;
+	char					*fields[ACC_INFO_NUM];
+	char					data[];
+} UmAccInfoBlob;
+
+/* Phases of um_usb_server_init() in the order they are run */
+typedef enum {
+	STARTUP_PHASE_VALUE_INIT = 0,
+	STARTUP_PHASE_PROC_INIT,
+	STARTUP_PHASE_DRIVER_CHECK,
+	STARTUP_PHASE_VCONF_NOTIFY,
+	STARTUP_PHASE_USB_STATUS,
+	STARTUP_PHASE_IPC_SERVER,		/* Deferred */
+	STARTUP_PHASE_UEVENT,			/* Deferred */
+	STARTUP_PHASE_HEYNOTI,			/* Deferred */
+	MAX_NUM_STARTUP_PHASE
+} STARTUP_PHASE;
+
+/* Timestamps from ecore_time_get(). 0 if the phase is not run yet */
+typedef struct _UmStartupReport {
+	double					start;
+	double					phaseBegin[MAX_NUM_STARTUP_PHASE];
+	double					phaseEnd[MAX_NUM_STARTUP_PHASE];
+} UmStartupReport;
+
+/* Time from plugging the cable, or from a mode change, until the host configures the gadget */
+typedef struct _UmEnumReport {
+	double					start;			/* -1 if not known */
+	double					last;			/* -1 if the host did not configure it */
+	double					sum;
+	double					max;
+	unsigned int			numConfigured;
+	unsigned int			numTimeouts;
+} UmEnumReport;
+
+/* vconf keys read by usb-server */
+typedef enum {
+	VCONF_USB_STATUS = 0,		/* VCONFKEY_SYSMAN_USB_STATUS */
+	VCONF_USB_SEL_MODE,			/* VCONFKEY_SETAPPL_USB_SEL_MODE_INT */
+	VCONF_USB_MODE,				/* VCONFKEY_SETAPPL_USB_MODE_INT */
+	VCONF_MOBILE_HOTSPOT,		/* VCONFKEY_MOBILE_HOTSPOT_MODE */
+	VCONF_ACC_STATUS,			/* VCONFKEY_USB_ACCESSORY_STATUS */
+	VCONF_USB_IN_MODE_CHANGE,	/* VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE */
+	MAX_NUM_VCONF_CACHE
+} VCONF_CACHE_KEY;
+
+typedef struct _UmVconfCache {
+	int						value[MAX_NUM_VCONF_CACHE];
+	Eina_Bool				valid[MAX_NUM_VCONF_CACHE];
+	Eina_Bool				subscribed[MAX_NUM_VCONF_CACHE];
+	unsigned int			hits;			/* Backend reads avoided */
+	unsigned int			fills;			/* Backend reads */
+	unsigned int			updates;		/* Values from change notifications */
+	unsigned int			writes;
+	Eina_Bool				echo[MAX_NUM_VCONF_CACHE];	/* Written, notification not seen yet */
+	unsigned int			echoes;			/* Own notifications skipped */
+	int						batchDepth;		/* Nested um_vconf_batch_begin() */
+	Eina_Bool				pending[MAX_NUM_VCONF_CACHE];	/* Set in the batch, not written yet */
+	unsigned int			batches;		/* Batches committed */
+} UmVconfCache;
+
+/* Events usb-server sends to itself */
+typedef enum {
+	UM_EVENT_MODE_REQUEST = 0,	/* value is the requested USB mode */
+	MAX_NUM_UM_EVENT
+} UM_EVENT;
+
+#define UM_EVENT_QUEUE_LEN		8
+
+typedef struct _UmEvent {
+	UM_EVENT				event;
+	int						value;
+} UmEvent;
+
+typedef struct _UmEventBus {
+	Ecore_Job				*job;			/* Dispatches the queue */
+	UmEvent					queue[UM_EVENT_QUEUE_LEN];
+	int						head;
+	int						num;
+	unsigned int			posted;
+	unsigned int			dropped;
+} UmEventBus;
+
 typedef struct _UmMainData {
 	Ecore_Fd_Handler		*ipcRequestServerFdHandler;
 	int						server_sock_local;
-	int						server_sock_remote;
+	Ecore_Fd_Handler		*ipcBinServerFdHandler;
+	int						server_sock_bin;
+	struct _UmIpcConn		*ipcConns;		/* Connected IPC clients */
+	int						numIpcConns;
 
 	int 					acc_noti_fd;
+	int						ueventSock;
+	Ecore_Fd_Handler		*ueventFdHandler;
+	unsigned long long		ueventSeqnum;	/* Last handled uevent */
 
 	UsbAccessory 			*usbAcc;
+	UmAccInfoBlob			*accInfo;		/* Never NULL after umAccInfoInit() */
+	unsigned int			accInfoGeneration;
 	char 					*permittedPkgForAcc;
 	char 					*launchedApp;
 
 	/* System status */
 	USB_DRIVER_VERSION 		driverVersion;
+	UmVconfCache			vconfCache;
+	UmEventBus				eventBus;
 
 	/* USB connection */
 	int						usbSelMode;
+	int						stagedMode;		/* Kernel mode written while unplugged, -1 if none */
+
+	/* Startup */
+	UmStartupReport			startup;
+	Ecore_Job				*lazyInitJob;
+
+	/* USB cable status debouncing */
+	Ecore_Timer				*usbStatusTimer;
+	int						usbStatusApplied;	/* Last handled status, -1 if none */
+	unsigned int			usbStatusEvents;	/* Status changes notified */
+	unsigned int			usbStatusAbsorbed;	/* Status changes which were not handled */
+	double					usbStatusEventTime;	/* Last status change notified */
+
+	/* Host enumeration */
+	int						udcStateFd;
+	Ecore_Fd_Handler		*udcFdHandler;
+	Ecore_Timer				*udcTimer;
+	double					udcDeadline;
+	UmEnumReport			enumReport;
 } UmMainData;
 
 #endif /* __UM_DATA_H__ */
@@ -0,0 +1,45 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_DATA_ROUTER_H__
+#define __UM_DATA_ROUTER_H__
+
+#include "um_common.h"
+#include "um_process_manager.h"
+
+#define DR_PROC_NAME				"data-router"
+/* Restart delays in seconds. The delay doubles every time data-router dies
+ * within DR_STABLE_TIME of being started */
+#define DR_RESTART_DELAY_MIN		1.0
+#define DR_RESTART_DELAY_MAX		60.0
+#define DR_STABLE_TIME				30.0
+
+/* data-router is started once and restarted if it dies while the current
+ * mode needs it. It is never stopped since other processes depend on it.
+ * The supervision lasts only as long as usb-server: without
+ * USB_SERVER_RESIDENT, usb-server exits on every unplug, so the restart
+ * delay starts again from DR_RESTART_DELAY_MIN on the next connection */
+int um_dr_start(const char *path);
+void um_dr_release();
+Eina_Bool um_dr_running();
+void um_dr_deinit();
+
+#endif /* __UM_DATA_ROUTER_H__ */
@@ -0,0 +1,40 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_EVENT_BUS_H__
+#define __UM_EVENT_BUS_H__
+
+#include "um_common.h"
+
+/* Requests which usb-server generates itself go to their handler through
+ * this queue instead of a vconf write and its notification. The queue is
+ * dispatched from the main loop, never from um_event_post() */
+typedef void (*um_event_cb)(UmMainData *ad, UM_EVENT event, int value);
+
+int um_event_subscribe(UM_EVENT event, um_event_cb cb);
+int um_event_post(UmMainData *ad, UM_EVENT event, int value);
+void um_event_bus_clear(UmMainData *ad);
+
+/* Writes the selected mode so that other processes see it,
+ * and posts UM_EVENT_MODE_REQUEST. The echo of the write is skipped */
+int um_event_mode_request(UmMainData *ad, int mode);
+
+#endif /* __UM_EVENT_BUS_H__ */
@@ -0,0 +1,103 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_IPC_SERVER_H__
+#define __UM_IPC_SERVER_H__
+
+#include "um_common.h"
+#include "um_usb_accessory_manager.h"
+#include <stdint.h>
+
+#define IPC_MAX_CONNECTIONS		64
+#define IPC_READ_BUF_LEN		(SOCK_STR_LEN * 2)
+#define IPC_MAX_FRAMES			32
+
+/* Binary protocol on SOCK_PATH_BIN (SOCK_SEQPACKET).
+ * Every message is one packet: a header followed by exactly payloadLen bytes.
+ * Packets of another size are dropped. Requests carry the appId
+ * as payload, responses the accessory information of GET_ACC_INFO.
+ * Requests can be pipelined; responses are matched by requestId.
+ * Both ends run on the same device, so the fields are in host byte order.
+ * A peer with another byte order or layout sends a wrong magic and is dropped.
+ * src/um_ipc_client.c is the reference client */
+#define IPC_BIN_MAGIC			0x55534253	/* "USBS" */
+#define IPC_BIN_VERSION			2
+#define IPC_BIN_MAX_PAYLOAD		SOCK_STR_LEN
+
+typedef enum {
+	IPC_BIN_REQUEST = 0,
+	IPC_BIN_RESPONSE
+} IPC_BIN_TYPE;
+
+typedef struct _UmIpcBinHeader {
+	uint32_t				magic;			/* IPC_BIN_MAGIC */
+	uint8_t					version;
+	uint8_t					type;			/* IPC_BIN_TYPE */
+	uint16_t				reserved;
+	uint32_t				requestId;
+	int32_t					command;		/* REQUEST_TO_USB_MANGER */
+	int32_t					result;			/* IPC_SIMPLE_RESULT, responses only */
+	uint32_t				generation;		/* Accessory information generation, GET_ACC_INFO only */
+	uint32_t				payloadLen;
+} UmIpcBinHeader;
+
+#define IPC_FRAME_HEAD_LEN		(sizeof(UmIpcBinHeader) + 16)
+
+typedef enum {
+	IPC_PROTO_TEXT = 0,
+	IPC_PROTO_BINARY
+} IPC_PROTO;
+
+/* Handles one request and returns IPC_SIMPLE_RESULT.
+ * If the request returns the accessory information, a reference is stored in blob;
+ * the text protocol then answers the blob text instead of the result */
+typedef int (*um_ipc_request_cb)(UmMainData *ad, int request, char *appId,
+								UmAccInfoBlob **blob);
+
+/* One answer. The blob is sent after head without being copied */
+typedef struct _UmIpcFrame {
+	char					head[IPC_FRAME_HEAD_LEN];	/* Binary header or text answer */
+	int						headLen;
+	UmAccInfoBlob			*blob;
+	int						blobLen;
+	int						sent;
+} UmIpcFrame;
+
+typedef struct _UmIpcConn {
+	int						fd;
+	Ecore_Fd_Handler		*fdHandler;
+	UmMainData				*ad;
+	IPC_PROTO				proto;
+
+	char					rbuf[IPC_READ_BUF_LEN];	/* Text protocol only */
+	int						rlen;
+	UmIpcFrame				frames[IPC_MAX_FRAMES];	/* Ring of answers to send */
+	int						frameHead;
+	int						numFrames;
+	Eina_Bool				closing;
+
+	struct _UmIpcConn		*next;
+} UmIpcConn;
+
+int um_ipc_server_start(UmMainData *ad, um_ipc_request_cb request);
+void um_ipc_server_stop(UmMainData *ad);
+
+#endif /* __UM_IPC_SERVER_H__ */
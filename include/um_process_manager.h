@@ -0,0 +1,55 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_PROCESS_MANAGER_H__
+#define __UM_PROCESS_MANAGER_H__
+
+#include "um_common.h"
+
+#define PROC_CMD_LEN	256
+#define PROC_MAX_ARGS	16
+#define PROC_REAP_POLL	0.05	/* Seconds. Children are polled if pidfds are not supported */
+
+/* Priority of a spawned child. Children without one get the priority
+ * usb-server had when um_proc_init() was called */
+typedef struct _UmProcPriority {
+	int				nice;
+	int				policy;		/* SCHED_OTHER, SCHED_BATCH or SCHED_IDLE */
+} UmProcPriority;
+
+/* Called from the main loop when a spawned child exits.
+ * status is the raw wait status, or -1 if the child could not be started */
+typedef void (*um_proc_done_cb)(pid_t pid, int status, void *data);
+
+int um_proc_init();
+void um_proc_deinit();
+pid_t um_proc_spawn(char *const argv[], um_proc_done_cb cb, void *data);
+pid_t um_proc_spawn_prio(char *const argv[], const UmProcPriority *prio,
+						um_proc_done_cb cb, void *data);
+int um_proc_run_cmd(const char *cmd, um_proc_done_cb cb, void *data);
+pid_t um_proc_spawn_cmd(const char *cmd, const UmProcPriority *prio,
+						um_proc_done_cb cb, void *data);
+int um_proc_base_nice();
+void um_proc_detach(pid_t pid);
+void um_proc_flush();
+Eina_Bool um_proc_watching();
+
+#endif /* __UM_PROCESS_MANAGER_H__ */
@@ -0,0 +1,51 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_RTNETLINK_H__
+#define __UM_RTNETLINK_H__
+
+#include "um_common.h"
+
+#define USB0_IFNAME				"usb0"
+#define USB0_ADDR				"192.168.129.3"
+#define USB0_NET				"192.168.129.0"
+#define USB0_PREFIX_LEN			24
+
+#define RTNL_MAX_MSGS			4
+#define RTNL_MSG_LEN			256
+#define RTNL_RECV_BUF_LEN		4096
+
+/* Called from the main loop once every request is acked.
+ * ret is 0 if all of them are applied, -1 otherwise */
+typedef void (*um_rtnl_done_cb)(int ret, void *data);
+
+/* All requests of a call are sent with one sendmsg() and each of them is acked.
+ * Existing or missing addresses and routes are not errors.
+ * Only one call waits for its acks, a new one cancels it.
+ * Returns -1 if the requests cannot be sent, then cb is not called */
+int um_rtnl_net_up(const char *ifname, const char *addr, const char *net, int prefixLen,
+					um_rtnl_done_cb cb, void *data);
+int um_rtnl_net_down(const char *ifname, const char *addr, int prefixLen,
+					um_rtnl_done_cb cb, void *data);
+/* Stops waiting for the acks, cb is not called. The kernel still applies the requests */
+void um_rtnl_cancel();
+
+#endif /* __UM_RTNETLINK_H__ */
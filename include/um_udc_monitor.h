@@ -0,0 +1,49 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_UDC_MONITOR_H__
+#define __UM_UDC_MONITOR_H__
+
+#include "um_common.h"
+
+#ifndef UDC_CLASS_PATH
+#define UDC_CLASS_PATH			"/sys/class/udc"	/* Can be set at build time */
+#endif
+#define UDC_STATE_CONFIGURED	"configured"
+#define UDC_STATE_BUF_LEN		32
+#define UDC_PATH_LEN			256
+#define UDC_POLL_INTERVAL		0.1		/* For drivers which do not notify state changes */
+#define UDC_CONFIGURED_TIMEOUT	5.0
+
+/* configured is EINA_FALSE if the host did not configure the gadget in time */
+typedef void (*um_udc_done_cb)(UmMainData *ad, Eina_Bool configured);
+
+/* Waits until the host configures the gadget and reports the time it took
+ * from ad->enumReport.start, or -1 if that is not known.
+ * Returns -1 if the UDC state cannot be read,
+ * then cb is not called */
+int um_udc_watch_start(UmMainData *ad, um_udc_done_cb cb);
+void um_udc_watch_stop(UmMainData *ad);
+Eina_Bool um_udc_watching(UmMainData *ad);
+/* Name of the first UDC in UDC_CLASS_PATH */
+int um_udc_name(char *name, int len);
+
+#endif /* __UM_UDC_MONITOR_H__ */
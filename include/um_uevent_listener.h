@@ -0,0 +1,42 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_UEVENT_LISTENER_H__
+#define __UM_UEVENT_LISTENER_H__
+
+#include "um_common.h"
+
+#define UEVENT_BUF_LEN			2048
+#define UEVENT_RCVBUF_LEN		(64 * 1024)
+
+typedef enum {
+	UEVENT_ACCESSORY_START = 0,
+	UEVENT_ACCESSORY_STOP
+} UEVENT_ACCESSORY;
+
+typedef void (*um_uevent_acc_cb)(UmMainData *ad, UEVENT_ACCESSORY event);
+
+/* Kernel uevents of USB_ACCESSORY_DEVPATH are handled in usb-server.
+ * The udev rule and heynoti keep working if the socket cannot be opened */
+int um_uevent_listener_start(UmMainData *ad, um_uevent_acc_cb cb);
+void um_uevent_listener_stop(UmMainData *ad);
+
+#endif /* __UM_UEVENT_LISTENER_H__ */
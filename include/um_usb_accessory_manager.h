@@ -35,3 +35,6 @@ int connectAccessory(UmMainData *ad);
 int disconnectAccessory(UmMainData *ad);
 void getCurrentAccessory();
 void umAccInfoInit(UmMainData *ad);
+UmAccInfoBlob *accInfoBlobNew(UsbAccessory *usbAcc, unsigned int generation);
+UmAccInfoBlob *accInfoBlobRef(UmAccInfoBlob *blob);
+void accInfoBlobUnref(UmAccInfoBlob *blob);
@@ -19,7 +19,14 @@
  *
  */
 
+#ifndef __UM_USB_CONNECTION_MANAGER_H__
+#define __UM_USB_CONNECTION_MANAGER_H__
+
 #include "um_customize.h"
+#include "um_process_manager.h"
+#include "um_usb_mode_planner.h"
+#include "um_rtnetlink.h"
+#include "um_udc_monitor.h"
 
 #define SDBD_START "/etc/init.d/sdbd start"
 #define SDBD_STOP  "/etc/init.d/sdbd stop"
@@ -33,17 +40,49 @@
 			"/etc/init.d/ssh start"
 #define OPENSSHD_STOP \
 			"/etc/init.d/ssh stop"
+#define MODE_STEP_MAX_CMDS	2
+
+/* Deadlines in seconds. Commands which overrun them are killed
+ * and the mode change fails */
+#define MODE_STEP_DEADLINE_SERVICE	10.0
+#define MODE_STEP_DEADLINE_NET		3.0
+#define MODE_PLAN_BUDGET			20.0
+
+/* The mode change which runs from the main loop. Its steps advance when
+ * their commands exit or miss their deadline, so the loop stays free.
+ * Only the newest requested mode is applied */
+typedef struct _UmTransition {
+	UmMainData		*ad;
+	UmModePlan		plan;
+	Eina_Bool		running;
+	Eina_Bool		cleaning;		/* The plan stops what a failed mode change left */
+	Eina_Bool		advancing;		/* In mode_transition_advance() */
+	double			budgetEnd;
+	Ecore_Timer		*timer;			/* Nearest deadline of the running steps */
+	Ecore_Job		*nextJob;		/* Starts pendingMode */
+	Eina_Bool		redirect;		/* The plan goes to redirectMode at the next step boundary */
+	int				redirectMode;
+	Eina_Bool		pending;		/* pendingMode is set when the running change is done */
+	int				pendingMode;
+	unsigned int	skipped;		/* Requested modes which were never applied */
+	Ecore_Cb		idleCb;			/* See mode_transition_wait() */
+	void			*idleData;
+} UmTransition;
 
-int action_clean(UmMainData *ad, int mode);
 int call_cmd(char* cmd);
 int connectUsb(UmMainData *ad);
 int disconnectUsb(UmMainData *ad);
 void change_mode_cb(keynode_t* in_key, void *data);
+void usb_mode_request_cb(UmMainData *ad, UM_EVENT event, int value);
 void change_hotspot_status_cb(keynode_t* in_key, void *data);
-static int check_mobile_hotspot_status();
-static int run_core_action(UmMainData *ad, int mode);
+static int check_mobile_hotspot_status(UmMainData *ad);
+int mode_transition_cancel(UmMainData *ad);
+int mode_transition_wait(Ecore_Cb cb, void *data);
 void select_kies_mode_popup(UmMainData *ad);
 int set_USB_mode(UmMainData *ad, int mode);
+Eina_Bool usb_mode_changing(UmMainData *ad);
+void stage_next_mode(UmMainData *ad);
 void change_hotspot_status_cb(keynode_t* in_key, void *data);
 void usb_connection_selected_btn(UmMainData *ad, int input);
 
+#endif /* __UM_USB_CONNECTION_MANAGER_H__ */
@@ -0,0 +1,132 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_USB_MODE_PLANNER_H__
+#define __UM_USB_MODE_PLANNER_H__
+
+#include "um_common.h"
+#include "um_process_manager.h"
+#include <sched.h>
+
+#define MAX_MODE_STEPS	16
+/* Used when the current mode cannot be read */
+#define MODE_PLAN_UNKNOWN_MODE	(-1000)
+
+/* Services which are run for a USB mode */
+#define MODE_SERVICE_DATA_ROUTER	(1 << 0)
+#define MODE_SERVICE_SDBD			(1 << 1)
+#define MODE_SERVICE_SSHD			(1 << 2)
+#define MAX_NUM_MODE_SERVICE		3
+/* These services keep running when a mode no longer needs them.
+ * Their stop step only ends the supervision of usb-server */
+#define MODE_SERVICE_PERSISTENT		(MODE_SERVICE_DATA_ROUTER)
+/* These services use gadget functions, so they are stopped before
+ * and started after the kernel step */
+#define MODE_SERVICE_GADGET			(MODE_SERVICE_DATA_ROUTER | MODE_SERVICE_SDBD)
+
+typedef enum {
+	MODE_STEP_SERVICE_STOP = 0,
+	MODE_STEP_NET_DOWN,
+	MODE_STEP_KERNEL_DISABLE,
+	MODE_STEP_KERNEL_SET,
+	MODE_STEP_NET_UP,
+	MODE_STEP_SERVICE_START,
+	MAX_NUM_MODE_STEP_TYPE
+} MODE_STEP_TYPE;
+
+/* Priorities used while changing to a mode.
+ * Critical steps are the kernel and usb0 steps, the stops of gadget services
+ * and the starts of criticalServices. The other commands are helpers.
+ * Services are always started at the priority usb-server was started with */
+typedef struct _UmModePriority {
+	int				transitionNice;		/* usb-server while the plan runs */
+	int				criticalNice;		/* Short commands of critical steps */
+	UmProcPriority	helper;				/* Commands of the other steps */
+} UmModePriority;
+
+/* What a USB mode needs from the kernel, services and network */
+typedef struct _UmModeDesc {
+	int				mode;
+	int				kernelMode;		/* The mode given to mode_set_kernel() */
+	int				services;		/* MODE_SERVICE_* */
+	Eina_Bool		usb0Ip;			/* usb0 has an address and a route */
+	int				criticalServices;	/* The mode is not usable without them */
+	UmModePriority	prio;
+} UmModeDesc;
+
+typedef enum {
+	MODE_STEP_PENDING = 0,
+	MODE_STEP_RUNNING,
+	MODE_STEP_DONE
+} MODE_STEP_STATE;
+
+/* Steps form a graph: a step can run once the steps in deps are done */
+struct _UmModePlan;
+
+typedef struct _UmModeStep {
+	MODE_STEP_TYPE	type;
+	int				arg;			/* kernel mode or MODE_SERVICE_* */
+	unsigned int	deps;			/* Bit i is set if the step depends on steps[i] */
+	Eina_Bool		critical;
+
+	/* Filled while the plan runs */
+	struct _UmModePlan	*plan;		/* Owner, for the callbacks of the commands */
+	MODE_STEP_STATE	state;
+	int				numCmds;		/* Commands started so far */
+	pid_t			pid;			/* Running command */
+	Eina_Bool		rtnl;			/* Waits for rtnetlink acks */
+	double			begin;
+	double			end;
+	double			deadline;
+	Eina_Bool		timedOut;
+	int				nice;			/* Applied to the commands */
+	int				policy;
+} UmModeStep;
+
+typedef struct _UmModePlan {
+	int				from;
+	int				to;
+	int				numSteps;
+	UmModeStep		steps[MAX_MODE_STEPS];
+	const UmModePriority	*prio;		/* Of the target mode */
+	int				services;		/* Running when the plan starts */
+	Eina_Bool		usb0Ip;			/* usb0 is up when the plan starts */
+
+	/* Filled while the plan runs */
+	int				numDone;
+	int				numRunning;
+	int				numTimedOut;
+	Eina_Bool		failed;
+	double			begin;
+	double			end;
+	int				nice;			/* usb-server while the plan runs */
+	double			maxSlice;		/* Longest time the plan held the main loop */
+} UmModePlan;
+
+const UmModeDesc *um_mode_desc_get(int mode);
+int um_mode_plan_build(UmModePlan *plan, int from, int to, Eina_Bool forceKernel);
+int um_mode_plan_build_clean(UmModePlan *plan, int mode, int other);
+Eina_Bool um_mode_plan_redirectable(UmModePlan *plan);
+int um_mode_plan_redirect(UmModePlan *plan, int to);
+void um_mode_plan_log(UmModePlan *plan);
+void um_mode_plan_log_timing(UmModePlan *plan);
+
+#endif /* __UM_USB_MODE_PLANNER_H__ */
@@ -24,6 +24,9 @@
 #include "um_main.h"
 #include "um_usb_accessory_manager.h"
 #include "um_usb_connection_manager.h"
+#include "um_ipc_server.h"
+#include "um_uevent_listener.h"
 
 void um_signal_init();
 int um_usb_server_init();
+void um_startup_report(UmMainData *ad);
@@ -0,0 +1,52 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UM_VCONF_CACHE_H__
+#define __UM_VCONF_CACHE_H__
+
+#include "um_common.h"
+
+/* Reads return the cached value. It is filled once at startup, updated by
+ * change notifications and written through by um_vconf_set() */
+int um_vconf_cache_init(UmMainData *ad);
+void um_vconf_cache_deinit(UmMainData *ad);
+void um_vconf_cache_report(UmMainData *ad);
+
+/* Called first in the notify callbacks of the server, which other keys go without.
+ * Returns EINA_TRUE if the notification is the echo of um_vconf_set() */
+Eina_Bool um_vconf_cache_notify(UmMainData *ad, VCONF_CACHE_KEY key, keynode_t *in_key);
+
+int um_vconf_get(UmMainData *ad, VCONF_CACHE_KEY key, int *value);
+int um_vconf_set(UmMainData *ad, VCONF_CACHE_KEY key, int value);
+
+/* Between begin and commit, um_vconf_set() only updates the cache. Commit
+ * writes each key once with its final value, so listeners do not see the
+ * intermediate states. vconf_set() is not atomic: USB_MODE and then
+ * IN_MODE_CHANGE are written last, after the rest of the batch.
+ * Batches nest, the outermost commits */
+void um_vconf_batch_begin(UmMainData *ad);
+int um_vconf_batch_commit(UmMainData *ad);
+
+/* Cached check_usb_connection(). While the status settles it is newer than
+ * ad->usbStatusApplied, which mode changes follow */
+int um_usb_status(UmMainData *ad);
+
+#endif /* __UM_VCONF_CACHE_H__ */
@@ -38,6 +38,7 @@ rm -rf %{buildroot}
 
 vconftool set -t int memory/usb/mass_storage_status "0" -u 0 -i -f
 vconftool set -t int memory/usb/accessory_status "0" -u 5000 -i -f
+vconftool set -t int memory/usb/configured_time "-1" -u 5000 -i -f
 
 heynotitool set device_usb_accessory
 
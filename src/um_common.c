@@ -58,18 +58,11 @@ int launch_usb_syspopup(UmMainData *ad, POPUP_TYPE _popup_type)
 
 	if (SELECT_PKG_FOR_ACC_POPUP == _popup_type) {
 		int i;
-		char device[ACC_INFO_NUM][ACC_ELEMENT_LEN];
-		snprintf(device[ACC_MANUFACTURER], ACC_ELEMENT_LEN, "%s", ad->usbAcc->manufacturer);
-		snprintf(device[ACC_MODEL], ACC_ELEMENT_LEN, "%s", ad->usbAcc->model);
-		snprintf(device[ACC_DESCRIPTION], ACC_ELEMENT_LEN, "%s", ad->usbAcc->description);
-		snprintf(device[ACC_VERSION], ACC_ELEMENT_LEN, "%s", ad->usbAcc->version);
-		snprintf(device[ACC_URI], ACC_ELEMENT_LEN, "%s", ad->usbAcc->uri);
-		snprintf(device[ACC_SERIAL], ACC_ELEMENT_LEN, "%s", ad->usbAcc->serial);
+		um_retvm_if(!(ad->accInfo), -1, "FAIL: No accessory information\n");
 		for ( i = 0; i < ACC_INFO_NUM ; i++) {
 			snprintf(syspopup_key, SYSPOPUP_PARAM_LEN, "%d", 1 + i);
-			snprintf(syspopup_value, ACC_ELEMENT_LEN, "%s", device[i]);
-			USB_LOG("key: %s, value: %s\n", syspopup_key, syspopup_value);
-			ret = bundle_add(b, syspopup_key, syspopup_value);
+			USB_LOG("key: %s, value: %s\n", syspopup_key, ad->accInfo->fields[i]);
+			ret = bundle_add(b, syspopup_key, ad->accInfo->fields[i]);
 			if (0 != ret) {
 				USB_LOG("FAIL: bundle_add()\n");
 				if (0 != bundle_free(b)) USB_LOG("FAIL: bundle_free()\n");
@@ -104,46 +97,56 @@ void load_system_popup(UmMainData *ad, POPUP_TYPE _popup_type)
 	__USB_FUNC_EXIT__ ;
 }
 
-int ipc_request_server_init()
+int ipc_server_socket_init(const char *path, int type)
 {
 	__USB_FUNC_ENTER__ ;
-	int len, t;
+	if (!path) return -1;
+	int len;
 	int sockFd = -1;
 	struct sockaddr_un local;
 
-	if ((sockFd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+	if ((sockFd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
 		perror("socket");
-		USB_LOG("FAIL: socket(AF_UNIX, SOCK_STREAM, 0)");
+		USB_LOG("FAIL: socket(AF_UNIX, %d, 0)", type);
 		return -1;
 	}
 	local.sun_family = AF_UNIX;
-	strncpy(local.sun_path, SOCK_PATH, strlen(SOCK_PATH)+1);
+	strncpy(local.sun_path, path, strlen(path)+1);
 	unlink(local.sun_path);
 	len = strlen(local.sun_path) + sizeof(local.sun_family);
 
 	if (bind(sockFd, (struct sockaddr *)&local, len) == -1) {
 		perror("bind");
 		USB_LOG("FAIL: bind((*sock_local), (struct sockaddr *)&local, len)");
+		close(sockFd);
 		return -1;
 	}
-	chown(SOCK_PATH, 5000, 5000);
-	chmod(SOCK_PATH, 0777);
-	if (listen(sockFd, 5) == -1) {
+	chown(path, 5000, 5000);
+	chmod(path, 0777);
+	if (listen(sockFd, IPC_LISTEN_BACKLOG) == -1) {
 		perror("listen");
-		USB_LOG("FAIL: listen((*sock_local), 5)");
+		USB_LOG("FAIL: listen((*sock_local), %d)", IPC_LISTEN_BACKLOG);
+		close(sockFd);
 		return -1;
 	}
 	__USB_FUNC_EXIT__ ;
 	return sockFd;
 }
 
+int ipc_request_server_init()
+{
+	return ipc_server_socket_init(SOCK_PATH, SOCK_STREAM);
+}
+
 int ipc_request_server_close(UmMainData *ad)
 {
 	__USB_FUNC_ENTER__ ;
 	if (ad->server_sock_local > 0)
 		close(ad->server_sock_local);
-	if (ad->server_sock_remote > 0)
-		close(ad->server_sock_remote);
+	ad->server_sock_local = -1;
+	if (ad->server_sock_bin > 0)
+		close(ad->server_sock_bin);
+	ad->server_sock_bin = -1;
 	__USB_FUNC_EXIT__ ;
 	return 0;
 }
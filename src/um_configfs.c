@@ -0,0 +1,355 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_configfs.h"
+#include "um_udc_monitor.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+static const UmConfigfsGadget configfsGadgets[] = {
+	{ SETTING_USB_DEFAULT_MODE,		"default",		"0x04e8", "0x6860", "239", "2", "1",
+				"SAMSUNG_Android",	{ "mtp.gs0", "acm.gs0", "ffs.sdb" } },
+	{ SETTING_USB_DEBUG_MODE,		"rndis",		"0x04e8", "0x6863", "239", "2", "1",
+				"SAMSUNG_Android",	{ "rndis.usb0", NULL, } },
+	{ SETTING_USB_ACCESSORY_MODE,	"accessory",	"0x18d1", "0x2d00", "0", "0", "0",
+				"Android Accessory",	{ "accessory.gs2", NULL, } }
+};
+
+#define NUM_CONFIGFS_GADGETS	(int)(sizeof(configfsGadgets) / sizeof(configfsGadgets[0]))
+
+static const UmConfigfsGadget *boundGadget = NULL;
+static const UmConfigfsGadget *ffsGadget = NULL;	/* Bound once its FunctionFS daemons are ready */
+static Ecore_Timer *ffsTimer = NULL;
+static double ffsDeadline = 0;
+static um_configfs_bound_cb boundCb = NULL;
+static UmMainData *boundData = NULL;
+
+static int configfs_mkdir(const char *path)
+{
+	if (mkdir(path, 0755) < 0 && EEXIST != errno) {
+		USB_LOG("FAIL: mkdir(%s) errno: %d\n", path, errno);
+		return -1;
+	}
+	return 0;
+}
+
+static int configfs_write(const char *dir, const char *attr, const char *value)
+{
+	char path[CONFIGFS_PATH_LEN];
+	int len = strlen(value);
+	int fd;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, attr);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	um_retvm_if(fd < 0, -1, "FAIL: open(%s) errno: %d\n", path, errno);
+	ret = write(fd, value, len);
+	close(fd);
+	um_retvm_if(ret != len, -1, "FAIL: write(%s, %s) errno: %d\n", path, value, errno);
+	return 0;
+}
+
+static int configfs_gadget_path(const UmConfigfsGadget *gadget, const char *sub,
+								char *path, int len)
+{
+	if (sub)
+		return snprintf(path, len, "%s/%s%s/%s", USB_CONFIGFS_ROOT,
+						CONFIGFS_GADGET_PREFIX, gadget->name, sub);
+	return snprintf(path, len, "%s/%s%s", USB_CONFIGFS_ROOT, CONFIGFS_GADGET_PREFIX, gadget->name);
+}
+
+/* Directories appear with their attributes in configfs, so only the values are written */
+static int configfs_gadget_build(const UmConfigfsGadget *gadget)
+{
+	__USB_FUNC_ENTER__ ;
+	char dir[CONFIGFS_PATH_LEN];
+	char path[CONFIGFS_PATH_LEN];
+	int i;
+
+	configfs_gadget_path(gadget, NULL, dir, sizeof(dir));
+	if (configfs_mkdir(dir) < 0) return -1;
+	if (configfs_write(dir, "idVendor", gadget->idVendor) < 0) return -1;
+	if (configfs_write(dir, "idProduct", gadget->idProduct) < 0) return -1;
+	if (configfs_write(dir, "bDeviceClass", gadget->bDeviceClass) < 0) return -1;
+	if (configfs_write(dir, "bDeviceSubClass", gadget->bDeviceSubClass) < 0) return -1;
+	if (configfs_write(dir, "bDeviceProtocol", gadget->bDeviceProtocol) < 0) return -1;
+
+	configfs_gadget_path(gadget, "strings", path, sizeof(path));
+	if (configfs_mkdir(path) < 0) return -1;
+	configfs_gadget_path(gadget, "strings/" CONFIGFS_LANG, path, sizeof(path));
+	if (configfs_mkdir(path) < 0) return -1;
+	if (configfs_write(path, "product", gadget->product) < 0) return -1;
+
+	configfs_gadget_path(gadget, "configs", path, sizeof(path));
+	if (configfs_mkdir(path) < 0) return -1;
+	configfs_gadget_path(gadget, "configs/" CONFIGFS_CONFIG, path, sizeof(path));
+	if (configfs_mkdir(path) < 0) return -1;
+	configfs_gadget_path(gadget, "functions", path, sizeof(path));
+	if (configfs_mkdir(path) < 0) return -1;
+
+	/* FunctionFS instances can be mounted once their function exists */
+	for (i = 0 ; i < CONFIGFS_MAX_FUNCS && gadget->funcs[i] ; i++) {
+		snprintf(path, sizeof(path), "%s/functions/%s", dir, gadget->funcs[i]);
+		if (configfs_mkdir(path) < 0) return -1;
+	}
+
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* FunctionFS creates the endpoint files once its daemon wrote the descriptors to ep0 */
+static Eina_Bool configfs_func_ready(const char *func)
+{
+	char path[CONFIGFS_PATH_LEN];
+
+	if (strncmp(func, CONFIGFS_FFS_PREFIX, strlen(CONFIGFS_FFS_PREFIX)))
+		return EINA_TRUE;
+	snprintf(path, sizeof(path), "%s/%s/ep1", USB_FFS_ROOT,
+					func + strlen(CONFIGFS_FFS_PREFIX));
+	return (0 == access(path, F_OK)) ? EINA_TRUE : EINA_FALSE;
+}
+
+/* Links the ready functions into the configuration and unlinks the others.
+ * Returns the number of functions left out, -1 on failure */
+static int configfs_gadget_link(const UmConfigfsGadget *gadget)
+{
+	char dir[CONFIGFS_PATH_LEN];
+	char path[CONFIGFS_PATH_LEN];
+	char link[CONFIGFS_PATH_LEN];
+	int notReady = 0;
+	int i;
+
+	configfs_gadget_path(gadget, NULL, dir, sizeof(dir));
+	for (i = 0 ; i < CONFIGFS_MAX_FUNCS && gadget->funcs[i] ; i++) {
+		snprintf(path, sizeof(path), "%s/functions/%s", dir, gadget->funcs[i]);
+		snprintf(link, sizeof(link), "%s/configs/%s/%s", dir, CONFIGFS_CONFIG, gadget->funcs[i]);
+		if (EINA_FALSE == configfs_func_ready(gadget->funcs[i])) {
+			if (unlink(link) < 0 && ENOENT != errno) {
+				USB_LOG("FAIL: unlink(%s) errno: %d\n", link, errno);
+				return -1;
+			}
+			notReady++;
+			continue;
+		}
+		if (symlink(path, link) < 0 && EEXIST != errno) {
+			USB_LOG("FAIL: symlink(%s) errno: %d\n", link, errno);
+			return -1;
+		}
+	}
+	return notReady;
+}
+
+static const UmConfigfsGadget *configfs_gadget_get(int mode)
+{
+	int i;
+	for (i = 0 ; i < NUM_CONFIGFS_GADGETS ; i++) {
+		if (mode == configfsGadgets[i].mode) return &(configfsGadgets[i]);
+	}
+	return NULL;
+}
+
+/* Writing an empty line unbinds the gadget */
+static int configfs_gadget_bind(const UmConfigfsGadget *gadget, const char *udc)
+{
+	char dir[CONFIGFS_PATH_LEN];
+
+	configfs_gadget_path(gadget, NULL, dir, sizeof(dir));
+	return configfs_write(dir, "UDC", udc ? udc : "\n");
+}
+
+static void configfs_ffs_wait_stop()
+{
+	if (ffsTimer) {
+		ecore_timer_del(ffsTimer);
+		ffsTimer = NULL;
+	}
+	ffsGadget = NULL;
+	boundCb = NULL;
+	boundData = NULL;
+}
+
+/* Links the functions which are ready and binds the gadget to the UDC */
+static int configfs_gadget_link_bind(const UmConfigfsGadget *gadget)
+{
+	__USB_FUNC_ENTER__ ;
+	char udc[CONFIGFS_UDC_LEN];
+
+	um_retvm_if(um_udc_name(udc, sizeof(udc)) < 0, -1, "FAIL: um_udc_name()\n");
+	um_retvm_if(configfs_gadget_link(gadget) < 0, -1,
+					"FAIL: Link the functions of %s\n", gadget->name);
+	um_retvm_if(configfs_gadget_bind(gadget, udc) < 0, -1, "FAIL: Bind %s\n", gadget->name);
+	boundGadget = gadget;
+	USB_LOG("Gadget %s is bound to %s\n", gadget->name, udc);
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+static Eina_Bool configfs_gadget_ready(const UmConfigfsGadget *gadget)
+{
+	int i;
+	for (i = 0 ; i < CONFIGFS_MAX_FUNCS && gadget->funcs[i] ; i++) {
+		if (EINA_FALSE == configfs_func_ready(gadget->funcs[i])) return EINA_FALSE;
+	}
+	return EINA_TRUE;
+}
+
+static void configfs_ffs_wait_done(const UmConfigfsGadget *gadget)
+{
+	__USB_FUNC_ENTER__ ;
+	um_configfs_bound_cb cb = boundCb;
+	UmMainData *ad = boundData;
+	int ret = -1;
+
+	configfs_ffs_wait_stop();
+	ret = configfs_gadget_link_bind(gadget);
+	if (cb) cb(ad, (0 == ret) ? EINA_TRUE : EINA_FALSE);
+	__USB_FUNC_EXIT__ ;
+}
+
+/* The gadget is bound once every FunctionFS function of it is ready */
+static Eina_Bool configfs_ffs_wait_cb(void *data)
+{
+	const UmConfigfsGadget *gadget = ffsGadget;
+
+	if (!gadget) {
+		ffsTimer = NULL;
+		return ECORE_CALLBACK_CANCEL;
+	}
+	if (EINA_FALSE == configfs_gadget_ready(gadget)) {
+		if (ecore_time_get() < ffsDeadline) return ECORE_CALLBACK_RENEW;
+		USB_LOG("ERROR: FunctionFS of %s is not ready after %.1f s. Bind it without\n",
+					gadget->name, CONFIGFS_FFS_TIMEOUT);
+	}
+
+	ffsTimer = NULL;
+	configfs_ffs_wait_done(gadget);
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static Eina_Bool configfs_gadget_bound(const UmConfigfsGadget *gadget)
+{
+	char path[CONFIGFS_PATH_LEN];
+	char buf[CONFIGFS_UDC_LEN];
+	int len;
+	int fd;
+
+	configfs_gadget_path(gadget, "UDC", path, sizeof(path));
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return EINA_FALSE;
+	len = read(fd, buf, sizeof(buf));
+	close(fd);
+	return (len > 0 && '\n' != buf[0]) ? EINA_TRUE : EINA_FALSE;
+}
+
+int um_configfs_init()
+{
+	__USB_FUNC_ENTER__ ;
+	int i;
+
+	um_retvm_if(access(USB_CONFIGFS_ROOT, W_OK) != 0, -1,
+					"%s is not available\n", USB_CONFIGFS_ROOT);
+
+	/* Timers do not survive ecore_shutdown() */
+	ffsTimer = NULL;
+	configfs_ffs_wait_stop();
+	boundGadget = NULL;
+	for (i = 0 ; i < NUM_CONFIGFS_GADGETS ; i++) {
+		um_retvm_if(configfs_gadget_build(&(configfsGadgets[i])) < 0, -1,
+					"FAIL: configfs_gadget_build(%s)\n", configfsGadgets[i].name);
+		if (EINA_TRUE == configfs_gadget_bound(&(configfsGadgets[i])))
+			boundGadget = &(configfsGadgets[i]);
+	}
+	USB_LOG("%d configfs gadgets are ready, %s is bound\n", NUM_CONFIGFS_GADGETS,
+					boundGadget ? boundGadget->name : "none");
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+int um_configfs_set(int mode)
+{
+	__USB_FUNC_ENTER__ ;
+	const UmConfigfsGadget *gadget = NULL;
+	char udc[CONFIGFS_UDC_LEN];
+
+	if (SETTING_USB_NONE_MODE != mode) {
+		gadget = configfs_gadget_get(mode);
+		um_retvm_if(!gadget, -1, "ERROR : parameter is not available(mode : %d)\n", mode);
+	}
+	if (gadget && gadget == ffsGadget) {
+		USB_LOG("Gadget %s waits for its FunctionFS daemons\n", gadget->name);
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+	if (!ffsGadget && gadget == boundGadget) {
+		USB_LOG("Gadget %s is already bound\n", gadget ? gadget->name : "none");
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+
+	configfs_ffs_wait_stop();
+	/* A UDC takes one gadget at a time */
+	if (boundGadget) {
+		um_retvm_if(configfs_gadget_bind(boundGadget, NULL) < 0, -1,
+						"FAIL: Unbind %s\n", boundGadget->name);
+		boundGadget = NULL;
+	}
+	if (!gadget) {
+		USB_LOG("No gadget is bound\n");
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+	if (EINA_TRUE == configfs_gadget_ready(gadget)) {
+		um_retvm_if(configfs_gadget_link_bind(gadget) < 0, -1,
+						"FAIL: configfs_gadget_link_bind(%s)\n", gadget->name);
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+
+	/* A missing UDC fails the mode change now rather than at the deferred bind */
+	um_retvm_if(um_udc_name(udc, sizeof(udc)) < 0, -1, "FAIL: um_udc_name()\n");
+	ffsDeadline = ecore_time_get() + CONFIGFS_FFS_TIMEOUT;
+	ffsTimer = ecore_timer_add(CONFIGFS_FFS_POLL, configfs_ffs_wait_cb, NULL);
+	if (!ffsTimer) {
+		USB_LOG("FAIL: ecore_timer_add(FunctionFS). Bind %s without its daemons\n",
+					gadget->name);
+		um_retvm_if(configfs_gadget_link_bind(gadget) < 0, -1,
+						"FAIL: configfs_gadget_link_bind(%s)\n", gadget->name);
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+	ffsGadget = gadget;
+	USB_LOG("Gadget %s is bound once its FunctionFS daemons are ready\n", gadget->name);
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+Eina_Bool um_configfs_binding()
+{
+	return ffsGadget ? EINA_TRUE : EINA_FALSE;
+}
+
+int um_configfs_wait_bound(um_configfs_bound_cb cb, UmMainData *ad)
+{
+	if (!cb || !ffsGadget) return -1;
+	boundCb = cb;
+	boundData = ad;
+	return 0;
+}
@@ -20,6 +20,54 @@
  */
 
 #include "um_customize.h"
+#include <fcntl.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+typedef struct _UmKernelNode {
+	const char	*path;
+	int			fd;
+	Eina_Bool	shadowValid;
+	char		shadow[KERNEL_NODE_BUF_LEN];	/* Last value written to the node */
+} UmKernelNode;
+
+/* The nodes of driver 1.0 are opened once and kept open */
+static UmKernelNode kernelNodes[MAX_NUM_USB_NODE] = {
+	{ USB_MODE_ENABLE,		-1, EINA_FALSE, "" },
+	{ USB_VENDOR_ID,		-1, EINA_FALSE, "" },
+	{ USB_PRODUCT_ID,		-1, EINA_FALSE, "" },
+	{ USB_FUNCTIONS,		-1, EINA_FALSE, "" },
+	{ USB_DEVICE_CLASS,		-1, EINA_FALSE, "" },
+	{ USB_DEVICE_SUBCLASS,	-1, EINA_FALSE, "" },
+	{ USB_DEVICE_PROTOCOL,	-1, EINA_FALSE, "" }
+};
+static unsigned int kernelNodeWrites = 0;
+static unsigned int kernelNodeSkips = 0;
+
+typedef enum {
+	KERNEL_NODE_BACKEND_SYNC = 0,
+	KERNEL_NODE_BACKEND_URING,
+	MAX_NUM_KERNEL_NODE_BACKEND
+} KERNEL_NODE_BACKEND;
+
+static const char *kernelNodeBackendNames[MAX_NUM_KERNEL_NODE_BACKEND] = { "pwrite", "io_uring" };
+
+/* Gadget switches done by each backend and the time they took, to compare them */
+typedef struct _UmKernelNodeStats {
+	unsigned int	numSets;
+	double			sum;
+	double			min;
+	double			max;
+} UmKernelNodeStats;
+
+static UmKernelNodeStats kernelNodeStats[MAX_NUM_KERNEL_NODE_BACKEND];
+
+#ifdef HAVE_LIBURING
+/* One ring for the whole chain of writes of a gadget switch */
+static struct io_uring kernelNodeRing;
+static Eina_Bool kernelNodeRingReady = EINA_FALSE;
+#endif
 
 /* If other kernel versions are added, we should modify this function */
 int check_driver_version(UmMainData *ad)
@@ -32,8 +80,13 @@ int check_driver_version(UmMainData *ad)
 	FILE *fp = NULL;
 
 	if (access(DRIVER_VERSION_PATH, F_OK) != 0) {
-		USB_LOG("This kernel is for C210\n");
-		ad->driverVersion = USB_DRIVER_0_0;
+		if (0 == um_configfs_init()) {
+			USB_LOG("This kernel uses the USB gadget configfs\n");
+			ad->driverVersion = USB_DRIVER_CONFIGFS;
+		} else {
+			USB_LOG("This kernel is for C210\n");
+			ad->driverVersion = USB_DRIVER_0_0;
+		}
 	} else {
 		fp = fopen(DRIVER_VERSION_PATH, "r");
 		um_retvm_if(fp == NULL, -1, "FAIL: fopen(%s)\n", DRIVER_VERSION_PATH);
@@ -54,6 +107,8 @@ int check_driver_version(UmMainData *ad)
 		if (strncmp(buffer, DRIVER_VERSION_1_0, strlen(DRIVER_VERSION_1_0)) == 0 ) {
 			USB_LOG("The driver version is 1.0 \n");
 			ad->driverVersion = USB_DRIVER_1_0;
+			if (0 != kernel_node_cache_init())
+				USB_LOG("FAIL: kernel_node_cache_init()\n");
 		} else {
 			USB_LOG("This kernel version is unknown\n");
 			return -1;
@@ -76,9 +131,13 @@ int mode_set_kernel(USB_DRIVER_VERSION _version, int mode)
 		break;
 	case USB_DRIVER_1_0:
 		USB_LOG("This target uses a concept which USB mode can be enabled/disabled\n");
-		ret = mode_set_driver_1_0(mode);
+		ret = mode_set_driver_1_0(mode, EINA_TRUE);
 		um_retvm_if (0 != ret, -1, "FAIL: mode_set_driver_1_0(mode)\n");
 		break;
+	case USB_DRIVER_CONFIGFS:
+		ret = um_configfs_set(mode);
+		um_retvm_if (0 != ret, -1, "FAIL: um_configfs_set(mode)\n");
+		break;
 
 	/* If other kernel versions are added, add functions here that notice USB mode to the kernel */
 
@@ -91,6 +150,29 @@ int mode_set_kernel(USB_DRIVER_VERSION _version, int mode)
 	return 0;
 }
 
+/* Writes the descriptors of mode but leaves the gadget disabled,
+ * so that only enable is left to write when the cable is connected.
+ * Driver 0.0 has a single node which switches the mode, so nothing can be staged.
+ * configfs gadgets are built at startup, so they are always staged */
+int mode_stage_kernel(USB_DRIVER_VERSION _version, int mode)
+{
+	__USB_FUNC_ENTER__ ;
+	int ret = -1;
+
+	if (USB_DRIVER_CONFIGFS == _version) {
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+	if (USB_DRIVER_1_0 != _version) {
+		__USB_FUNC_EXIT__ ;
+		return -1;
+	}
+	ret = mode_set_driver_1_0(mode, EINA_FALSE);
+	um_retvm_if (0 != ret, -1, "FAIL: mode_set_driver_1_0(%d)\n", mode);
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
 static int mode_set_driver_0_0(int mode)
 {
 	__USB_FUNC_ENTER__ ;
@@ -124,47 +206,301 @@ static int mode_set_driver_0_0(int mode)
 	__USB_FUNC_EXIT__ ;
 	return 0;
 }
-static int driver_1_0_kernel_node_set(char *vendor_id, char *product_id, char *functions,
-								char *device_class, char *device_subclass, char* device_protocol)
+
+int kernel_node_cache_init()
+{
+	__USB_FUNC_ENTER__ ;
+	int i;
+	int len;
+	int opened = 0;
+	UmKernelNode *node;
+
+	for (i = 0 ; i < MAX_NUM_USB_NODE ; i++) {
+		node = &(kernelNodes[i]);
+		if (node->fd >= 0) {
+			opened++;
+			continue;
+		}
+		node->shadowValid = EINA_FALSE;
+		node->fd = open(node->path, O_RDWR | O_CLOEXEC);
+		if (node->fd < 0) {
+			/* Some nodes are write only */
+			node->fd = open(node->path, O_WRONLY | O_CLOEXEC);
+			if (node->fd < 0) {
+				USB_LOG("FAIL: open(%s). write_file() will be used\n", node->path);
+				continue;
+			}
+		} else {
+			/* The current value becomes the first shadow value */
+			len = pread(node->fd, node->shadow, KERNEL_NODE_BUF_LEN - 1, 0);
+			if (len > 0) {
+				if ('\n' == node->shadow[len - 1]) len--;
+				node->shadow[len] = '\0';
+				node->shadowValid = EINA_TRUE;
+			}
+		}
+		opened++;
+	}
+	USB_LOG("%d of %d kernel nodes are cached\n", opened, MAX_NUM_USB_NODE);
+
+#ifdef HAVE_LIBURING
+	if (EINA_FALSE == kernelNodeRingReady) {
+		i = io_uring_queue_init(KERNEL_NODE_RING_DEPTH, &kernelNodeRing, 0);
+		if (0 == i)
+			kernelNodeRingReady = EINA_TRUE;
+		else
+			USB_LOG("FAIL: io_uring_queue_init(): %s. pwrite() will be used\n", strerror(-i));
+	}
+#endif
+
+	__USB_FUNC_EXIT__ ;
+	return (opened > 0) ? 0 : -1;
+}
+
+void kernel_node_cache_deinit()
+{
+	__USB_FUNC_ENTER__ ;
+	UmKernelNodeStats *stats = NULL;
+	int i;
+	for (i = 0 ; i < MAX_NUM_USB_NODE ; i++) {
+		if (kernelNodes[i].fd >= 0) {
+			close(kernelNodes[i].fd);
+			kernelNodes[i].fd = -1;
+		}
+		kernelNodes[i].shadowValid = EINA_FALSE;
+	}
+#ifdef HAVE_LIBURING
+	if (EINA_TRUE == kernelNodeRingReady) {
+		io_uring_queue_exit(&kernelNodeRing);
+		kernelNodeRingReady = EINA_FALSE;
+	}
+#endif
+	for (i = 0 ; i < MAX_NUM_KERNEL_NODE_BACKEND ; i++) {
+		stats = &(kernelNodeStats[i]);
+		if (0 == stats->numSets) continue;
+		USB_LOG("Gadget switches with %s: %u, %.3f ms on average, %.3f - %.3f ms\n",
+						kernelNodeBackendNames[i], stats->numSets,
+						stats->sum * 1000 / stats->numSets, stats->min * 1000, stats->max * 1000);
+	}
+	__USB_FUNC_EXIT__ ;
+}
+
+/* Descriptor nodes are not rewritten if they already hold the value.
+ * enable is always written since it triggers (re)enumeration */
+static Eina_Bool kernel_node_unchanged(USB_KERNEL_NODE type, char *content)
+{
+	UmKernelNode *node = &(kernelNodes[type]);
+
+	if (USB_NODE_ENABLE == type || EINA_FALSE == node->shadowValid) return EINA_FALSE;
+	if (strncmp(node->shadow, content, KERNEL_NODE_BUF_LEN)) return EINA_FALSE;
+	USB_LOG("%s is already %s\n", node->path, content);
+	return EINA_TRUE;
+}
+
+static void kernel_node_written(USB_KERNEL_NODE type, char *content, Eina_Bool ret)
+{
+	UmKernelNode *node = &(kernelNodes[type]);
+
+	kernelNodeWrites++;
+	if (EINA_TRUE == ret) {
+		snprintf(node->shadow, KERNEL_NODE_BUF_LEN, "%s", content);
+		node->shadowValid = EINA_TRUE;
+	} else {
+		node->shadowValid = EINA_FALSE;
+	}
+}
+
+static Eina_Bool kernel_node_write(USB_KERNEL_NODE type, char *content)
+{
+	__USB_FUNC_ENTER__ ;
+	if (type < 0 || type >= MAX_NUM_USB_NODE || !content) return EINA_FALSE;
+	UmKernelNode *node = &(kernelNodes[type]);
+	Eina_Bool ret = EINA_FALSE;
+	int len = strlen(content);
+
+	if (EINA_TRUE == kernel_node_unchanged(type, content)) {
+		kernelNodeSkips++;
+		__USB_FUNC_EXIT__ ;
+		return EINA_TRUE;
+	}
+
+	if (node->fd < 0) {
+		ret = write_file(node->path, content);
+	} else if (pwrite(node->fd, content, len, 0) == len) {
+		ret = EINA_TRUE;
+	} else {
+		USB_LOG("FAIL: pwrite(%s, %s)\n", node->path, content);
+	}
+	kernel_node_written(type, content, ret);
+
+	__USB_FUNC_EXIT__ ;
+	return ret;
+}
+
+#ifdef HAVE_LIBURING
+/* Submits the writes as one chain of linked requests and waits for all of them.
+ * If a write fails, the kernel cancels the writes after it.
+ * Returns 0 on success, -1 if a write failed and 1 if the ring cannot be used */
+static int kernel_nodes_write_uring(USB_KERNEL_NODE *types, char **contents, int num)
 {
 	__USB_FUNC_ENTER__ ;
+	struct io_uring_sqe *sqe = NULL;
+	struct io_uring_cqe *cqe = NULL;
+	UmKernelNode *node = NULL;
+	int result[KERNEL_NODE_RING_DEPTH];
+	int failed = 0;
 	int ret = -1;
+	int i;
 
-	if (vendor_id == NULL || product_id == NULL || functions == NULL
-			|| device_class == NULL || device_subclass == NULL || device_protocol == NULL) {
-		USB_LOG("ERROR: There are parameters whose value is NULL\n");
-		return -1;
+	if (EINA_FALSE == kernelNodeRingReady || num > KERNEL_NODE_RING_DEPTH) return 1;
+	for (i = 0 ; i < num ; i++) {
+		if (kernelNodes[types[i]].fd < 0) return 1;
 	}
 
-	ret = write_file(USB_MODE_ENABLE, "0");
-	um_retvm_if(EINA_FALSE == ret, -1, "FAIL: write_file(%s)\n", USB_MODE_ENABLE);
+	for (i = 0 ; i < num ; i++) {
+		sqe = io_uring_get_sqe(&kernelNodeRing);
+		um_retvm_if(!sqe, 1, "FAIL: io_uring_get_sqe()\n");
+		io_uring_prep_write(sqe, kernelNodes[types[i]].fd, contents[i], strlen(contents[i]), 0);
+		io_uring_sqe_set_data(sqe, (void *)(long)i);
+		if (i < num - 1) sqe->flags |= IOSQE_IO_LINK;
+		result[i] = -ECANCELED;
+	}
 
-	ret = write_file(USB_VENDOR_ID, vendor_id);
-	um_retvm_if(EINA_FALSE == ret, -1, "FAIL: write_file(%s)\n", USB_VENDOR_ID); 
+	ret = io_uring_submit_and_wait(&kernelNodeRing, num);
+	if (ret < num) {
+		/* The requests may still be queued. A new ring is made on the next cache init */
+		USB_LOG("FAIL: io_uring_submit_and_wait() returns %d. Use pwrite()\n", ret);
+		io_uring_queue_exit(&kernelNodeRing);
+		kernelNodeRingReady = EINA_FALSE;
+		__USB_FUNC_EXIT__ ;
+		return 1;
+	}
 
-	ret = write_file(USB_PRODUCT_ID, product_id);
-	um_retvm_if(EINA_FALSE == ret, -1, "FAIL: write_file(%s)\n", USB_PRODUCT_ID);
+	for (i = 0 ; i < num ; i++) {
+		ret = io_uring_wait_cqe(&kernelNodeRing, &cqe);
+		if (ret < 0) {
+			USB_LOG("FAIL: io_uring_wait_cqe(): %s\n", strerror(-ret));
+			break;
+		}
+		result[(long)io_uring_cqe_get_data(cqe)] = cqe->res;
+		io_uring_cqe_seen(&kernelNodeRing, cqe);
+	}
 
-	ret = write_file(USB_FUNCTIONS, functions);
-	um_retvm_if(EINA_FALSE == ret, -1, "FAIL: write_file(%s)\n", USB_FUNCTIONS);
+	for (i = 0 ; i < num ; i++) {
+		node = &(kernelNodes[types[i]]);
+		if (result[i] == strlen(contents[i])) {
+			kernel_node_written(types[i], contents[i], EINA_TRUE);
+			continue;
+		}
+		if (-ECANCELED == result[i]) {
+			/* Not written, so the shadow value is still right */
+			USB_LOG("%s is not written after a failed write\n", node->path);
+		} else if (result[i] < 0) {
+			USB_LOG("FAIL: write(%s, %s): %s\n", node->path, contents[i], strerror(-result[i]));
+			kernel_node_written(types[i], contents[i], EINA_FALSE);
+		} else {
+			USB_LOG("FAIL: write(%s, %s) writes %d bytes\n", node->path, contents[i], result[i]);
+			kernel_node_written(types[i], contents[i], EINA_FALSE);
+		}
+		failed++;
+	}
 
-	ret = write_file(USB_DEVICE_CLASS, device_class);
-	um_retvm_if(EINA_FALSE == ret, -1, "FAIL: write_file(%s)\n", USB_DEVICE_CLASS);
+	__USB_FUNC_EXIT__ ;
+	return (failed > 0) ? -1 : 0;
+}
+#endif
 
-	ret = write_file(USB_DEVICE_SUBCLASS, device_subclass);
-	um_retvm_if(EINA_FALSE == ret, -1, "FAIL: write_file(%s)\n", USB_DEVICE_SUBCLASS);
+/* If enable is EINA_FALSE, the gadget is left disabled */
+static int driver_1_0_kernel_node_set(char *vendor_id, char *product_id, char *functions,
+								char *device_class, char *device_subclass, char* device_protocol,
+								Eina_Bool enable)
+{
+	__USB_FUNC_ENTER__ ;
+	USB_KERNEL_NODE types[MAX_NUM_USB_NODE + 1];
+	char *contents[MAX_NUM_USB_NODE + 1];
+	char *descs[MAX_NUM_USB_NODE];
+	KERNEL_NODE_BACKEND backend = KERNEL_NODE_BACKEND_SYNC;
+	UmKernelNodeStats *stats = NULL;
+	double begin;
+	double elapsed;
+	int num = 0;
+	int ret = -1;
+	int i;
 
-	ret = write_file(USB_DEVICE_PROTOCOL, device_protocol);
-	um_retvm_if(EINA_FALSE == ret, -1, "FAIL: write_file(%s)\n", USB_DEVICE_PROTOCOL);
+	if (vendor_id == NULL || product_id == NULL || functions == NULL
+			|| device_class == NULL || device_subclass == NULL || device_protocol == NULL) {
+		USB_LOG("ERROR: There are parameters whose value is NULL\n");
+		return -1;
+	}
 
-	ret = write_file(USB_MODE_ENABLE, "1");
-	um_retvm_if(EINA_FALSE == ret, -1, "FAIL: write_file(%s)\n", USB_MODE_ENABLE);
+	descs[USB_NODE_VENDOR_ID] = vendor_id;
+	descs[USB_NODE_PRODUCT_ID] = product_id;
+	descs[USB_NODE_FUNCTIONS] = functions;
+	descs[USB_NODE_DEVICE_CLASS] = device_class;
+	descs[USB_NODE_DEVICE_SUBCLASS] = device_subclass;
+	descs[USB_NODE_DEVICE_PROTOCOL] = device_protocol;
+
+	kernelNodeWrites = 0;
+	kernelNodeSkips = 0;
+	begin = ecore_time_get();
+
+	/* enable=0, the descriptors which change, then enable=1, in this order.
+	 * enable=0 is not needed if the descriptors were staged while unplugged */
+	if (EINA_TRUE == kernelNodes[USB_NODE_ENABLE].shadowValid
+			&& !strncmp(kernelNodes[USB_NODE_ENABLE].shadow, "0", KERNEL_NODE_BUF_LEN)) {
+		USB_LOG("%s is already 0\n", USB_MODE_ENABLE);
+		kernelNodeSkips++;
+	} else {
+		types[num] = USB_NODE_ENABLE;
+		contents[num++] = "0";
+	}
+	for (i = USB_NODE_VENDOR_ID ; i < MAX_NUM_USB_NODE ; i++) {
+		if (EINA_TRUE == kernel_node_unchanged(i, descs[i])) {
+			kernelNodeSkips++;
+			continue;
+		}
+		types[num] = i;
+		contents[num++] = descs[i];
+	}
+	if (EINA_TRUE == enable) {
+		types[num] = USB_NODE_ENABLE;
+		contents[num++] = "1";
+	}
+	if (num <= 0) {
+		USB_LOG("Kernel nodes are already staged\n");
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
 
+#ifdef HAVE_LIBURING
+	ret = kernel_nodes_write_uring(types, contents, num);
+	um_retvm_if(ret < 0, -1, "FAIL: kernel_nodes_write_uring()\n");
+	if (0 == ret) backend = KERNEL_NODE_BACKEND_URING;
+#endif
+
+	if (KERNEL_NODE_BACKEND_SYNC == backend) {
+		for (i = 0 ; i < num ; i++) {
+			ret = kernel_node_write(types[i], contents[i]);
+			um_retvm_if(EINA_FALSE == ret, -1, "FAIL: kernel_node_write(%s)\n",
+							kernelNodes[types[i]].path);
+		}
+	}
+
+	elapsed = ecore_time_get() - begin;
+	if (EINA_TRUE == enable) {
+		stats = &(kernelNodeStats[backend]);
+		if (0 == stats->numSets || elapsed < stats->min) stats->min = elapsed;
+		if (0 == stats->numSets || elapsed > stats->max) stats->max = elapsed;
+		stats->sum += elapsed;
+		stats->numSets++;
+	}
+	USB_LOG("Kernel nodes written: %u, skipped: %u in %.3f ms with %s\n", kernelNodeWrites,
+					kernelNodeSkips, elapsed * 1000, kernelNodeBackendNames[backend]);
 	__USB_FUNC_EXIT__ ;
 	return 0;
 }
 
-static int mode_set_driver_1_0(int mode)
+static int mode_set_driver_1_0(int mode, Eina_Bool enable)
 {
 	__USB_FUNC_ENTER__ ;
 
@@ -174,28 +510,28 @@ static int mode_set_driver_1_0(int mode)
 	{
 	case SETTING_USB_DEFAULT_MODE:
 		USB_LOG("Mode : SETTING_USB_DEFAULT mode_set_kernel\n");
-		ret = driver_1_0_kernel_node_set("04e8", "6860", "mtp,acm,sdb", "239", "2", "1");
+		ret = driver_1_0_kernel_node_set("04e8", "6860", "mtp,acm,sdb", "239", "2", "1", enable);
 		__USB_FUNC_EXIT__ ;
 		return ret;
 
 	case SETTING_USB_DEBUG_MODE:
 		USB_LOG("Mode : USB_DEBUG_MODE mode_set_kernel\n");
-		ret = driver_1_0_kernel_node_set("04e8", "6863", "rndis", "239", "2", "1");
+		ret = driver_1_0_kernel_node_set("04e8", "6863", "rndis", "239", "2", "1", enable);
 		__USB_FUNC_EXIT__ ;
 		return ret;
 
 	case SETTING_USB_ACCESSORY_MODE:
 		USB_LOG("Mode : USB_ACCESSORY_MODE mode_set_kernel\n");
-		ret = driver_1_0_kernel_node_set("18d1", "2d00", "accessory", "0", "0", "0");
+		ret = driver_1_0_kernel_node_set("18d1", "2d00", "accessory", "0", "0", "0", enable);
 		__USB_FUNC_EXIT__ ;
 		return ret;
 
 	case SETTING_USB_NONE_MODE:
 		USB_LOG("Mode : USB_NONE_MODE mode_set_kernel\n");
-		ret = write_file(USB_MODE_ENABLE, "0");
-		um_retvm_if(EINA_FALSE == ret, -1, "FAIL: write_file(%s)\n", USB_MODE_ENABLE);
+		ret = kernel_node_write(USB_NODE_ENABLE, "0");
+		um_retvm_if(EINA_FALSE == ret, -1, "FAIL: kernel_node_write(%s)\n", USB_MODE_ENABLE);
 		__USB_FUNC_EXIT__ ;
-		return ret;
+		return 0;
 
 	default:
 		USB_LOG("ERROR : parameter is not available(mode : %d)\n", mode);
@@ -208,7 +544,22 @@ void start_dr(UmMainData *ad)
 {
 	__USB_FUNC_ENTER__ ;
 	if(!ad) return ;
-	call_cmd(CMD_DR_START);
+	/* data-router does not exit, so it can only be supervised if children are not waited for */
+	if (EINA_FALSE == um_proc_watching()) {
+		call_cmd(CMD_DR_START);
+		__USB_FUNC_EXIT__ ;
+		return ;
+	}
+	if (0 != um_dr_start(DATA_ROUTER_PATH)) USB_LOG("FAIL: um_dr_start()\n");
+	__USB_FUNC_EXIT__ ;
+}
+
+/* data-router keeps running for the processes which use it */
+void stop_dr(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	if(!ad) return ;
+	um_dr_release();
 	__USB_FUNC_EXIT__ ;
 }
 
@@ -258,7 +609,7 @@ void load_connection_popup(UmMainData *ad)
 		return;
 	}
 
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT, &usbCurMode);
+	ret = um_vconf_get(ad, VCONF_USB_MODE, &usbCurMode);
 	USB_LOG("usbCurMode: %d\n", usbCurMode);
 	switch(usbCurMode) {
 	case SETTING_USB_DEFAULT_MODE:
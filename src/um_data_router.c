@@ -0,0 +1,264 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_data_router.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/syscall.h>
+
+static char drPath[PROC_CMD_LEN];
+static pid_t drPid = -1;
+static Eina_Bool drChild = EINA_FALSE;	/* Spawned by usb-server, reaped by the process manager */
+static int drPidfd = -1;				/* Watches a data-router which usb-server did not spawn */
+static Ecore_Fd_Handler *drPidfdHandler = NULL;
+static Ecore_Timer *drRestartTimer = NULL;
+static Eina_Bool drWanted = EINA_FALSE;
+static Eina_Bool drScanned = EINA_FALSE;
+static double drStartTime = 0;
+static double drRestartDelay = 0;
+static unsigned int drRestarts = 0;
+
+static int dr_spawn();
+
+/* Finds a data-router which was started before usb-server */
+static pid_t dr_scan_proc()
+{
+	__USB_FUNC_ENTER__ ;
+	char path[PROC_CMD_LEN];
+	char comm[32];
+	struct dirent *entry;
+	DIR *dir = NULL;
+	pid_t pid = -1;
+	int fd;
+	int len;
+
+	dir = opendir("/proc");
+	um_retvm_if(!dir, -1, "FAIL: opendir(/proc)\n");
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] < '1' || entry->d_name[0] > '9') continue;
+		snprintf(path, sizeof(path), "/proc/%s/comm", entry->d_name);
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) continue;
+		len = read(fd, comm, sizeof(comm) - 1);
+		close(fd);
+		if (len <= 0) continue;
+		comm[len] = '\0';
+		if (comm[len - 1] == '\n') comm[len - 1] = '\0';
+		if (!strcmp(comm, DR_PROC_NAME)) {
+			pid = atoi(entry->d_name);
+			break;
+		}
+	}
+	closedir(dir);
+	__USB_FUNC_EXIT__ ;
+	return pid;
+}
+
+static void dr_unwatch()
+{
+	if (drPidfdHandler) {
+		ecore_main_fd_handler_del(drPidfdHandler);
+		drPidfdHandler = NULL;
+	}
+	if (drPidfd >= 0) {
+		close(drPidfd);
+		drPidfd = -1;
+	}
+}
+
+static Eina_Bool dr_restart_cb(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	drRestartTimer = NULL;
+	if (drWanted && drPid < 0) {
+		drRestarts++;
+		if (0 != dr_spawn()) USB_LOG("FAIL: dr_spawn()\n");
+	}
+	__USB_FUNC_EXIT__ ;
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static void dr_exited(int status)
+{
+	__USB_FUNC_ENTER__ ;
+	double now = ecore_time_get();
+
+	USB_LOG("data-router(%d) exits with %d\n", drPid, status);
+	drPid = -1;
+	drChild = EINA_FALSE;
+	dr_unwatch();
+
+	if (!drWanted || drRestartTimer) return;
+
+	if (drRestartDelay <= 0 || now - drStartTime >= DR_STABLE_TIME)
+		drRestartDelay = DR_RESTART_DELAY_MIN;
+	else if (drRestartDelay * 2 > DR_RESTART_DELAY_MAX)
+		drRestartDelay = DR_RESTART_DELAY_MAX;
+	else
+		drRestartDelay *= 2;
+
+	USB_LOG("data-router is restarted in %.1f s (restarts: %u)\n", drRestartDelay, drRestarts);
+	drRestartTimer = ecore_timer_add(drRestartDelay, dr_restart_cb, NULL);
+	if (!drRestartTimer) USB_LOG("FAIL: ecore_timer_add(dr_restart_cb)\n");
+	__USB_FUNC_EXIT__ ;
+}
+
+static void dr_child_done(pid_t pid, int status, void *data)
+{
+	if (!drChild || pid != drPid) return;
+	dr_exited(status);
+}
+
+static Eina_Bool dr_pidfd_cb(void *data, Ecore_Fd_Handler *fd_handler)
+{
+	__USB_FUNC_ENTER__ ;
+	if (ecore_main_fd_handler_active_get(fd_handler, ECORE_FD_READ) == EINA_FALSE)
+		return ECORE_CALLBACK_RENEW;
+	/* The pidfd is readable once the process exits */
+	dr_exited(-1);
+	__USB_FUNC_EXIT__ ;
+	return ECORE_CALLBACK_RENEW;
+}
+
+/* Watches a data-router which is not a child of usb-server */
+static int dr_watch(pid_t pid)
+{
+	__USB_FUNC_ENTER__ ;
+#ifdef SYS_pidfd_open
+	drPidfd = syscall(SYS_pidfd_open, pid, 0);
+	um_retvm_if(drPidfd < 0, -1, "FAIL: pidfd_open(%d) errno: %d\n", pid, errno);
+
+	drPidfdHandler = ecore_main_fd_handler_add(drPidfd, ECORE_FD_READ,
+							dr_pidfd_cb, NULL, NULL, NULL);
+	if (!drPidfdHandler) {
+		USB_LOG("FAIL: ecore_main_fd_handler_add(drPidfd)\n");
+		close(drPidfd);
+		drPidfd = -1;
+		return -1;
+	}
+	__USB_FUNC_EXIT__ ;
+	return 0;
+#else
+	USB_LOG("pidfd is not supported. data-router(%d) is checked on demand\n", pid);
+	__USB_FUNC_EXIT__ ;
+	return -1;
+#endif
+}
+
+static int dr_spawn()
+{
+	__USB_FUNC_ENTER__ ;
+	char *argv[] = { drPath, NULL };
+	pid_t pid;
+
+	pid = um_proc_spawn(argv, dr_child_done, NULL);
+	um_retvm_if(pid < 0, -1, "FAIL: um_proc_spawn(%s)\n", drPath);
+
+	drPid = pid;
+	drChild = EINA_TRUE;
+	drStartTime = ecore_time_get();
+	USB_LOG("data-router(%d) is started\n", pid);
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+Eina_Bool um_dr_running()
+{
+	if (drPid < 0) return EINA_FALSE;
+	/* Without a pidfd, an adopted data-router is only checked here */
+	if (!drChild && drPidfd < 0 && kill(drPid, 0) < 0 && ESRCH == errno) {
+		drPid = -1;
+		return EINA_FALSE;
+	}
+	return EINA_TRUE;
+}
+
+int um_dr_start(const char *path)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!path) return -1;
+	pid_t pid;
+
+	drWanted = EINA_TRUE;
+	snprintf(drPath, sizeof(drPath), "%s", path);
+
+	if (!drScanned) {
+		drScanned = EINA_TRUE;
+		pid = dr_scan_proc();
+		if (pid > 0) {
+			USB_LOG("data-router(%d) was started before\n", pid);
+			drPid = pid;
+			drChild = EINA_FALSE;
+			drStartTime = ecore_time_get();
+			dr_watch(pid);
+		}
+	}
+
+	if (um_dr_running()) {
+		USB_LOG("data-router(%d) is already running\n", drPid);
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+	if (drRestartTimer) {
+		USB_LOG("data-router is restarted soon\n");
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+
+	__USB_FUNC_EXIT__ ;
+	return dr_spawn();
+}
+
+/* No mode needs data-router any more. It keeps running but is not restarted */
+void um_dr_release()
+{
+	__USB_FUNC_ENTER__ ;
+	if (drRestartTimer) {
+		ecore_timer_del(drRestartTimer);
+		drRestartTimer = NULL;
+	}
+	if (drWanted) USB_LOG("data-router(%d) is not supervised any more\n", drPid);
+	drWanted = EINA_FALSE;
+	__USB_FUNC_EXIT__ ;
+}
+
+/* data-router keeps running; usb-server only stops watching it.
+ * It leads its own process group, and the process manager still reaps it
+ * when usb-server runs its main loop again, so it does not become a zombie.
+ * The next um_dr_start() finds it and watches it again */
+void um_dr_deinit()
+{
+	__USB_FUNC_ENTER__ ;
+	if (drRestartTimer) {
+		ecore_timer_del(drRestartTimer);
+		drRestartTimer = NULL;
+	}
+	if (drChild && drPid > 0) um_proc_detach(drPid);
+	dr_unwatch();
+	drPid = -1;
+	drChild = EINA_FALSE;
+	drWanted = EINA_FALSE;
+	drScanned = EINA_FALSE;
+	drRestartDelay = 0;
+	__USB_FUNC_EXIT__ ;
+}
@@ -0,0 +1,102 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_customize.h"
+
+static um_event_cb eventSubscribers[MAX_NUM_UM_EVENT];
+
+int um_event_subscribe(UM_EVENT event, um_event_cb cb)
+{
+	um_retvm_if(event < 0 || event >= MAX_NUM_UM_EVENT, -1, "Unknown event %d\n", event);
+	eventSubscribers[event] = cb;
+	return 0;
+}
+
+static void event_bus_dispatch(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	UmMainData *ad = (UmMainData *)data;
+	UmEventBus *bus = NULL;
+	UmEvent ev;
+	if (!ad) return;
+	bus = &(ad->eventBus);
+	bus->job = NULL;
+
+	/* Handlers can post again, which is dispatched in the same run */
+	while (bus->num > 0) {
+		ev = bus->queue[bus->head];
+		bus->head = (bus->head + 1) % UM_EVENT_QUEUE_LEN;
+		bus->num--;
+		if (eventSubscribers[ev.event])
+			eventSubscribers[ev.event](ad, ev.event, ev.value);
+	}
+	__USB_FUNC_EXIT__ ;
+}
+
+int um_event_post(UmMainData *ad, UM_EVENT event, int value)
+{
+	if (!ad) return -1;
+	UmEventBus *bus = &(ad->eventBus);
+	UmEvent *ev = NULL;
+	um_retvm_if(event < 0 || event >= MAX_NUM_UM_EVENT, -1, "Unknown event %d\n", event);
+
+	if (bus->num >= UM_EVENT_QUEUE_LEN) {
+		bus->dropped++;
+		USB_LOG_ERROR("Event queue is full, event %d dropped\n", event);
+		return -1;
+	}
+	if (!bus->job) {
+		bus->job = ecore_job_add(event_bus_dispatch, ad);
+		um_retvm_if(!bus->job, -1, "FAIL: ecore_job_add()\n");
+	}
+	ev = &(bus->queue[(bus->head + bus->num) % UM_EVENT_QUEUE_LEN]);
+	ev->event = event;
+	ev->value = value;
+	bus->num++;
+	bus->posted++;
+	return 0;
+}
+
+void um_event_bus_clear(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return;
+	UmEventBus *bus = &(ad->eventBus);
+
+	if (bus->job) {
+		ecore_job_del(bus->job);
+		bus->job = NULL;
+	}
+	USB_LOG("Event bus: %u posted, %u dropped, %d pending\n", bus->posted, bus->dropped, bus->num);
+	bus->head = 0;
+	bus->num = 0;
+	__USB_FUNC_EXIT__ ;
+}
+
+int um_event_mode_request(UmMainData *ad, int mode)
+{
+	if (!ad) return -1;
+	int ret = -1;
+
+	ret = um_vconf_set(ad, VCONF_USB_SEL_MODE, mode);
+	um_retvm_if(0 != ret, -1, "FAIL: vconf_set_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT)\n");
+	return um_event_post(ad, UM_EVENT_MODE_REQUEST, mode);
+}
@@ -0,0 +1,113 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/* Reference client of the binary protocol on SOCK_PATH_BIN.
+ * usb-server-ipc <request> [appId] sends one request and prints the response.
+ * request is a REQUEST_TO_USB_MANGER value */
+
+#include "um_ipc_server.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define IPC_CLIENT_REQUEST_ID	1
+
+static int ipc_client_connect()
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	memset(&addr, 0x0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", SOCK_PATH_BIN);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Sends one request and waits for its response. The payload of the response
+ * is stored NUL terminated in payload. Returns the payload length or -1 */
+static int ipc_client_request(int fd, uint32_t requestId, int command, const char *appId,
+							UmIpcBinHeader *res, char *payload, int len)
+{
+	char pkt[sizeof(UmIpcBinHeader) + IPC_BIN_MAX_PAYLOAD];
+	UmIpcBinHeader req;
+	int appIdLen = appId ? strlen(appId) : 0;
+	int ret;
+
+	if (appIdLen > IPC_BIN_MAX_PAYLOAD) return -1;
+	memset(&req, 0x0, sizeof(UmIpcBinHeader));
+	req.magic = IPC_BIN_MAGIC;
+	req.version = IPC_BIN_VERSION;
+	req.type = IPC_BIN_REQUEST;
+	req.requestId = requestId;
+	req.command = command;
+	req.payloadLen = appIdLen;
+	memcpy(pkt, &req, sizeof(UmIpcBinHeader));
+	if (appIdLen > 0) memcpy(pkt + sizeof(UmIpcBinHeader), appId, appIdLen);
+	if (send(fd, pkt, sizeof(UmIpcBinHeader) + appIdLen, MSG_NOSIGNAL) < 0) return -1;
+
+	/* A packet is one whole response */
+	do {
+		ret = recv(fd, pkt, sizeof(pkt), 0);
+	} while (ret < 0 && EINTR == errno);
+	if (ret < (int)sizeof(UmIpcBinHeader)) return -1;
+	memcpy(res, pkt, sizeof(UmIpcBinHeader));
+	if (IPC_BIN_MAGIC != res->magic || IPC_BIN_VERSION != res->version
+			|| IPC_BIN_RESPONSE != res->type || requestId != res->requestId
+			|| (uint32_t)ret != sizeof(UmIpcBinHeader) + res->payloadLen
+			|| res->payloadLen >= (uint32_t)len)
+		return -1;
+	memcpy(payload, pkt + sizeof(UmIpcBinHeader), res->payloadLen);
+	payload[res->payloadLen] = '\0';
+	return res->payloadLen;
+}
+
+int main(int argc, char **argv)
+{
+	char payload[IPC_BIN_MAX_PAYLOAD + 1];
+	UmIpcBinHeader res;
+	int fd;
+	int ret;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s <request> [appId]\n", argv[0]);
+		return 2;
+	}
+	fd = ipc_client_connect();
+	if (fd < 0) {
+		fprintf(stderr, "Cannot connect to %s: %s\n", SOCK_PATH_BIN, strerror(errno));
+		return 1;
+	}
+	ret = ipc_client_request(fd, IPC_CLIENT_REQUEST_ID, atoi(argv[1]),
+							(3 == argc) ? argv[2] : NULL, &res, payload, sizeof(payload));
+	close(fd);
+	if (ret < 0) {
+		fprintf(stderr, "No valid response to request %s\n", argv[1]);
+		return 1;
+	}
+	printf("result: %d\n", res.result);
+	if (ret > 0) printf("generation: %u\n%s\n", res.generation, payload);
+	return 0;
+}
@@ -0,0 +1,443 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_ipc_server.h"
+
+static um_ipc_request_cb ipcRequest = NULL;
+
+static void ipc_conn_close(UmIpcConn *conn)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!conn) return;
+	UmMainData *ad = conn->ad;
+	UmIpcConn **pp = &(ad->ipcConns);
+
+	while (*pp) {
+		if (*pp == conn) {
+			*pp = conn->next;
+			ad->numIpcConns--;
+			break;
+		}
+		pp = &((*pp)->next);
+	}
+	if (conn->fdHandler) {
+		ecore_main_fd_handler_del(conn->fdHandler);
+		conn->fdHandler = NULL;
+	}
+	while (conn->numFrames > 0) {
+		accInfoBlobUnref(conn->frames[conn->frameHead].blob);
+		conn->frameHead = (conn->frameHead + 1) % IPC_MAX_FRAMES;
+		conn->numFrames--;
+	}
+	close(conn->fd);
+	FREE(conn);
+	__USB_FUNC_EXIT__ ;
+}
+
+static UmIpcFrame *ipc_conn_frame_new(UmIpcConn *conn)
+{
+	UmIpcFrame *frame = NULL;
+	if (conn->numFrames >= IPC_MAX_FRAMES) {
+		USB_LOG("Waiting for the client to read the answers\n");
+		return NULL;
+	}
+	frame = &(conn->frames[(conn->frameHead + conn->numFrames) % IPC_MAX_FRAMES]);
+	memset(frame, 0x0, sizeof(UmIpcFrame));
+	conn->numFrames++;
+	return frame;
+}
+
+/* Text protocol: "<request>|<appId>" terminated by NUL */
+static int ipc_conn_process_text(UmIpcConn *conn, int *used)
+{
+	__USB_FUNC_ENTER__ ;
+	char msg[SOCK_STR_LEN];
+	char *end = NULL;
+	char *appId = NULL;
+	UmAccInfoBlob *blob = NULL;
+	UmIpcFrame *frame = NULL;
+	int off = 0;
+	int result;
+	int num = 0;
+
+	while (off < conn->rlen) {
+		end = memchr(conn->rbuf + off, '\0', conn->rlen - off);
+		if (!end) break;
+		frame = ipc_conn_frame_new(conn);
+		if (!frame) break;
+
+		snprintf(msg, SOCK_STR_LEN, "%s", conn->rbuf + off);
+		off += end - (conn->rbuf + off) + 1;
+
+		USB_LOG("[SERVER] Received value: %s", msg);
+		appId = strchr(msg, '|');
+		if (appId) {
+			*appId = '\0';
+			appId++;
+		} else {
+			appId = msg + strlen(msg);
+		}
+
+		blob = NULL;
+		result = ipcRequest(conn->ad, atoi(msg), appId, &blob);
+		if (blob) {
+			frame->blob = blob;
+			frame->blobLen = blob->textLen + 1;
+			USB_LOG("str: %s", blob->text);
+		} else {
+			snprintf(frame->head, IPC_FRAME_HEAD_LEN, "%d", result);
+			frame->headLen = strlen(frame->head) + 1;
+			USB_LOG("str: %s", frame->head);
+		}
+		num++;
+	}
+	*used = off;
+	__USB_FUNC_EXIT__ ;
+	return num;
+}
+
+/* Binary protocol: one packet is UmIpcBinHeader followed by exactly payloadLen bytes.
+ * Other packets are dropped. Returns the number of answered requests */
+static int ipc_conn_process_packet(UmIpcConn *conn, const char *pkt, int len)
+{
+	__USB_FUNC_ENTER__ ;
+	UmIpcBinHeader req;
+	UmIpcBinHeader res;
+	char appId[IPC_BIN_MAX_PAYLOAD + 1];
+	UmAccInfoBlob *blob = NULL;
+	UmIpcFrame *frame = NULL;
+
+	if (len < (int)sizeof(UmIpcBinHeader)) {
+		USB_LOG("ERROR: Packet of %d bytes is dropped\n", len);
+		return 0;
+	}
+	memcpy(&req, pkt, sizeof(UmIpcBinHeader));
+	if (IPC_BIN_MAGIC != req.magic || IPC_BIN_VERSION != req.version
+			|| IPC_BIN_REQUEST != req.type
+			|| (uint32_t)IPC_BIN_MAX_PAYLOAD < req.payloadLen
+			|| (uint32_t)len != sizeof(UmIpcBinHeader) + req.payloadLen) {
+		USB_LOG("ERROR: Wrong packet(magic: 0x%x, version: %d, type: %d, len: %u, size: %d) is dropped\n",
+					req.magic, req.version, req.type, req.payloadLen, len);
+		return 0;
+	}
+	frame = ipc_conn_frame_new(conn);
+	if (!frame) return 0;	/* Not reached, packets are read only if there is room */
+
+	memcpy(appId, pkt + sizeof(UmIpcBinHeader), req.payloadLen);
+	appId[req.payloadLen] = '\0';
+
+	memset(&res, 0x0, sizeof(UmIpcBinHeader));
+	res.magic = IPC_BIN_MAGIC;
+	res.version = IPC_BIN_VERSION;
+	res.type = IPC_BIN_RESPONSE;
+	res.requestId = req.requestId;
+	res.command = req.command;
+	res.result = ipcRequest(conn->ad, req.command, appId, &blob);
+	if (blob) {
+		res.generation = blob->generation;
+		res.payloadLen = blob->textLen;
+		frame->blob = blob;
+		frame->blobLen = blob->textLen;
+	}
+	USB_LOG("[SERVER] request %u(%d): %d\n", req.requestId, req.command, res.result);
+
+	memcpy(frame->head, &res, sizeof(UmIpcBinHeader));
+	frame->headLen = sizeof(UmIpcBinHeader);
+	__USB_FUNC_EXIT__ ;
+	return 1;
+}
+
+/* Answers every complete request in the read buffer as long as there is room
+ * for the answers. Returns the number of answered requests or -1 on error */
+static int ipc_conn_process(UmIpcConn *conn)
+{
+	__USB_FUNC_ENTER__ ;
+	int used = 0;
+	int num;
+
+	/* Binary packets are answered as they are read */
+	if (IPC_PROTO_BINARY == conn->proto)
+		return 0;
+	num = ipc_conn_process_text(conn, &used);
+
+	if (used > 0) {
+		memmove(conn->rbuf, conn->rbuf + used, conn->rlen - used);
+		conn->rlen -= used;
+	}
+	__USB_FUNC_EXIT__ ;
+	return num;
+}
+
+/* Each answer is sent with one gather write, which is also one packet
+ * for the binary protocol. Stream sockets may take a part of it */
+static Eina_Bool ipc_conn_flush(UmIpcConn *conn)
+{
+	__USB_FUNC_ENTER__ ;
+	UmIpcFrame *frame = NULL;
+	struct iovec iov[2];
+	struct msghdr msg;
+	int cnt;
+	int n;
+
+	while (conn->numFrames > 0) {
+		frame = &(conn->frames[conn->frameHead]);
+		cnt = 0;
+		if (frame->sent < frame->headLen) {
+			iov[cnt].iov_base = frame->head + frame->sent;
+			iov[cnt].iov_len = frame->headLen - frame->sent;
+			cnt++;
+		}
+		if (frame->blob) {
+			n = (frame->sent > frame->headLen) ? frame->sent - frame->headLen : 0;
+			iov[cnt].iov_base = frame->blob->text + n;
+			iov[cnt].iov_len = frame->blobLen - n;
+			cnt++;
+		}
+
+		memset(&msg, 0x0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = cnt;
+		n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (EINTR == errno) continue;
+			if (EAGAIN == errno || EWOULDBLOCK == errno) break;
+			USB_LOG("FAIL: sendmsg(%d) errno: %d\n", conn->fd, errno);
+			return EINA_FALSE;
+		}
+
+		frame->sent += n;
+		if (frame->sent < frame->headLen + frame->blobLen) continue;
+
+		accInfoBlobUnref(frame->blob);
+		frame->blob = NULL;
+		conn->frameHead = (conn->frameHead + 1) % IPC_MAX_FRAMES;
+		conn->numFrames--;
+	}
+	__USB_FUNC_EXIT__ ;
+	return EINA_TRUE;
+}
+
+/* A binary packet is answered as soon as it is read,
+ * so binary connections are read only if there is room for the answer */
+static Eina_Bool ipc_conn_can_read(UmIpcConn *conn)
+{
+	if (IPC_PROTO_BINARY == conn->proto)
+		return (conn->numFrames < IPC_MAX_FRAMES);
+	return (conn->rlen < IPC_READ_BUF_LEN);
+}
+
+static Eina_Bool ipc_conn_read(UmIpcConn *conn)
+{
+	__USB_FUNC_ENTER__ ;
+	char pkt[sizeof(UmIpcBinHeader) + IPC_BIN_MAX_PAYLOAD];
+	int n;
+
+	while (ipc_conn_can_read(conn)) {
+		/* One packet per recv(), MSG_TRUNC returns the real size of a longer one */
+		if (IPC_PROTO_BINARY == conn->proto)
+			n = recv(conn->fd, pkt, sizeof(pkt), MSG_TRUNC);
+		else
+			n = recv(conn->fd, conn->rbuf + conn->rlen, IPC_READ_BUF_LEN - conn->rlen, 0);
+		if (n > 0) {
+			if (IPC_PROTO_BINARY == conn->proto)
+				ipc_conn_process_packet(conn, pkt, n);
+			else
+				conn->rlen += n;
+			continue;
+		}
+		if (0 == n) {
+			conn->closing = EINA_TRUE;
+			break;
+		}
+		if (EINTR == errno) continue;
+		if (EAGAIN == errno || EWOULDBLOCK == errno) break;
+		USB_LOG("FAIL: recv(%d) errno: %d\n", conn->fd, errno);
+		return EINA_FALSE;
+	}
+	__USB_FUNC_EXIT__ ;
+	return EINA_TRUE;
+}
+
+static Eina_Bool ipc_conn_cb(void *data, Ecore_Fd_Handler *fd_handler)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!data) return ECORE_CALLBACK_CANCEL;
+	UmIpcConn *conn = (UmIpcConn *)data;
+	int num;
+	int flags = 0;
+
+	if (ecore_main_fd_handler_active_get(fd_handler, ECORE_FD_READ) == EINA_TRUE) {
+		if (EINA_FALSE == ipc_conn_read(conn)) {
+			ipc_conn_close(conn);
+			return ECORE_CALLBACK_RENEW;
+		}
+	}
+
+	do {
+		num = ipc_conn_process(conn);
+		if (num < 0 || EINA_FALSE == ipc_conn_flush(conn)) {
+			ipc_conn_close(conn);
+			return ECORE_CALLBACK_RENEW;
+		}
+	} while (num > 0 && conn->rlen > 0);
+
+	if (IPC_PROTO_TEXT == conn->proto
+			&& conn->rlen >= IPC_READ_BUF_LEN && !memchr(conn->rbuf, '\0', conn->rlen)) {
+		USB_LOG("ERROR: The request is too long\n");
+		ipc_conn_close(conn);
+		return ECORE_CALLBACK_RENEW;
+	}
+
+	if (conn->closing && conn->numFrames == 0) {
+		USB_LOG("Client %d is disconnected\n", conn->fd);
+		ipc_conn_close(conn);
+		return ECORE_CALLBACK_RENEW;
+	}
+
+	/* Stop reading while the answers cannot be stored */
+	if (!conn->closing && ipc_conn_can_read(conn))
+		flags |= ECORE_FD_READ;
+	if (conn->numFrames > 0)
+		flags |= ECORE_FD_WRITE;
+	ecore_main_fd_handler_active_set(fd_handler, flags);
+
+	__USB_FUNC_EXIT__ ;
+	return ECORE_CALLBACK_RENEW;
+}
+
+static void ipc_accept(UmMainData *ad, int sockFd, IPC_PROTO proto)
+{
+	__USB_FUNC_ENTER__ ;
+	UmIpcConn *conn = NULL;
+	int fd;
+
+	while (1) {
+		fd = accept4(sockFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (EINTR == errno) continue;
+			if (EAGAIN != errno && EWOULDBLOCK != errno)
+				USB_LOG("FAIL: accept4(%d) errno: %d\n", sockFd, errno);
+			break;
+		}
+
+		if (ad->numIpcConns >= IPC_MAX_CONNECTIONS) {
+			USB_LOG("ERROR: Too many IPC clients(%d)\n", ad->numIpcConns);
+			close(fd);
+			continue;
+		}
+
+		conn = (UmIpcConn *)calloc(1, sizeof(UmIpcConn));
+		if (!conn) {
+			USB_LOG("FAIL: calloc(UmIpcConn)\n");
+			close(fd);
+			continue;
+		}
+		conn->fd = fd;
+		conn->ad = ad;
+		conn->proto = proto;
+		conn->fdHandler = ecore_main_fd_handler_add(fd, ECORE_FD_READ,
+								ipc_conn_cb, conn, NULL, NULL);
+		if (!conn->fdHandler) {
+			USB_LOG("FAIL: ecore_main_fd_handler_add(%d)\n", fd);
+			close(fd);
+			FREE(conn);
+			continue;
+		}
+		conn->next = ad->ipcConns;
+		ad->ipcConns = conn;
+		ad->numIpcConns++;
+	}
+	__USB_FUNC_EXIT__ ;
+}
+
+static Eina_Bool ipc_accept_cb(void *data, Ecore_Fd_Handler *fd_handler)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!data) return ECORE_CALLBACK_CANCEL;
+	UmMainData *ad = (UmMainData *)data;
+
+	if (ecore_main_fd_handler_active_get(fd_handler, ECORE_FD_READ) == EINA_FALSE)
+		return ECORE_CALLBACK_RENEW;
+
+	if (fd_handler == ad->ipcBinServerFdHandler)
+		ipc_accept(ad, ad->server_sock_bin, IPC_PROTO_BINARY);
+	else
+		ipc_accept(ad, ad->server_sock_local, IPC_PROTO_TEXT);
+
+	__USB_FUNC_EXIT__ ;
+	return ECORE_CALLBACK_RENEW;
+}
+
+int um_ipc_server_start(UmMainData *ad, um_ipc_request_cb request)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad || !request) return -1;
+	ipcRequest = request;
+
+	ad->server_sock_local = ipc_request_server_init();
+	um_retvm_if(0 > ad->server_sock_local, -1, "FAIL: ipc_request_server_init()\n");
+
+	ad->ipcRequestServerFdHandler = ecore_main_fd_handler_add(ad->server_sock_local,
+							ECORE_FD_READ, ipc_accept_cb, ad, NULL, NULL);
+	if (NULL == ad->ipcRequestServerFdHandler) {
+		USB_LOG("FAIL: ecore_main_fd_handler_add()");
+		ipc_request_server_close(ad);
+		return -1;
+	}
+
+	/* The text protocol on SOCK_PATH is enough if this fails */
+	ad->server_sock_bin = ipc_server_socket_init(SOCK_PATH_BIN, SOCK_SEQPACKET);
+	if (0 > ad->server_sock_bin) {
+		USB_LOG("FAIL: ipc_server_socket_init(%s)\n", SOCK_PATH_BIN);
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+	ad->ipcBinServerFdHandler = ecore_main_fd_handler_add(ad->server_sock_bin,
+							ECORE_FD_READ, ipc_accept_cb, ad, NULL, NULL);
+	if (NULL == ad->ipcBinServerFdHandler) {
+		USB_LOG("FAIL: ecore_main_fd_handler_add(%s)", SOCK_PATH_BIN);
+		close(ad->server_sock_bin);
+		ad->server_sock_bin = -1;
+	}
+
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+void um_ipc_server_stop(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return;
+
+	if (ad->ipcRequestServerFdHandler != NULL) {
+		ecore_main_fd_handler_del(ad->ipcRequestServerFdHandler);
+		ad->ipcRequestServerFdHandler = NULL;
+	}
+	if (ad->ipcBinServerFdHandler != NULL) {
+		ecore_main_fd_handler_del(ad->ipcBinServerFdHandler);
+		ad->ipcBinServerFdHandler = NULL;
+	}
+	while (ad->ipcConns)
+		ipc_conn_close(ad->ipcConns);
+
+	ipc_request_server_close(ad);
+	__USB_FUNC_EXIT__ ;
+}
@@ -24,6 +24,9 @@
 static void fini(UmMainData *ad)
 {
 	__USB_FUNC_ENTER__;
+	um_dr_deinit();
+	um_proc_deinit();
+	kernel_node_cache_deinit();
 	__USB_FUNC_EXIT__;
 }
 
@@ -44,6 +47,8 @@ static int usb_server_main(int argc, char **argv)
 	ad.usbAcc = (UsbAccessory*)malloc(sizeof(UsbAccessory));
 
 	ecore_init();
+	/* Ecore only uses the monotonic clock once it is initialized */
+	ad.startup.start = ecore_time_get();
 
 	usb_server_init(&ad);
 
@@ -52,6 +57,7 @@ static int usb_server_main(int argc, char **argv)
 	fini(&ad);
 	ecore_shutdown();
 	FREE(ad.usbAcc);
+	accInfoBlobUnref(ad.accInfo);
 
 	if (VCONFKEY_SYSMAN_USB_AVAILABLE == check_usb_connection())
 		return 1;
@@ -0,0 +1,455 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_process_manager.h"
+#include <spawn.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+
+extern char **environ;
+
+typedef struct _UmProcChild {
+	pid_t					pid;
+	int						pidfd;		/* -1 if the child is polled */
+	Ecore_Fd_Handler		*handler;
+	um_proc_done_cb			cb;
+	void					*data;
+	struct _UmProcChild		*next;
+} UmProcChild;
+
+typedef struct _UmProcCmd {
+	char					cmd[PROC_CMD_LEN];
+	char					buf[PROC_CMD_LEN];
+	char					*argv[PROC_MAX_ARGS];
+	um_proc_done_cb			cb;
+	void					*data;
+	struct _UmProcCmd		*next;
+} UmProcCmd;
+
+static Eina_Bool watching = EINA_FALSE;
+static Ecore_Timer *reap_timer = NULL;	/* For children without a pidfd */
+static UmProcChild *children = NULL;
+static int base_nice = 0;
+
+/* Commands are run one after another in the order they are queued,
+ * as system() did, but without blocking the main loop */
+static UmProcCmd *cmd_head = NULL;
+static UmProcCmd *cmd_tail = NULL;
+static Eina_Bool cmd_busy = EINA_FALSE;
+static pid_t cmd_pid = -1;
+
+static void proc_cmd_next();
+
+static pid_t proc_spawn_child(char *const argv[], const UmProcPriority *prio)
+{
+	__USB_FUNC_ENTER__ ;
+	posix_spawnattr_t attr;
+	struct sched_param param;
+	sigset_t empty_mask;
+	short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP;
+	pid_t pid = -1;
+	int nice = prio ? prio->nice : base_nice;
+	int curNice;
+	int ret = -1;
+
+	ret = posix_spawnattr_init(&attr);
+	um_retvm_if(0 != ret, -1, "FAIL: posix_spawnattr_init()\n");
+
+	/* Children start with no blocked signal, whatever usb-server blocks */
+	sigemptyset(&empty_mask);
+	posix_spawnattr_setsigmask(&attr, &empty_mask);
+	/* Each child leads its own process group, so that it can be killed with its children */
+	posix_spawnattr_setpgroup(&attr, 0);
+#ifdef POSIX_SPAWN_USEVFORK
+	flags |= POSIX_SPAWN_USEVFORK;
+#endif
+	posix_spawnattr_setflags(&attr, flags);
+
+	/* The nice value cannot be given to posix_spawn(). usb-server takes the one
+	 * of the child while spawning it, so the child never runs with the priority
+	 * usb-server has during a mode change */
+	errno = 0;
+	curNice = getpriority(PRIO_PROCESS, 0);
+	if (0 != errno) curNice = nice;
+	if (curNice != nice && setpriority(PRIO_PROCESS, 0, nice) < 0)
+		USB_LOG("FAIL: setpriority(%d) errno: %d\n", nice, errno);
+
+	ret = posix_spawn(&pid, argv[0], NULL, &attr, argv, environ);
+	posix_spawnattr_destroy(&attr);
+
+	if (curNice != nice && setpriority(PRIO_PROCESS, 0, curNice) < 0)
+		USB_LOG("FAIL: setpriority(%d) errno: %d\n", curNice, errno);
+	um_retvm_if(0 != ret, -1, "FAIL: posix_spawn(%s) returns %d\n", argv[0], ret);
+
+	/* Spawn attributes only take SCHED_OTHER, SCHED_FIFO and SCHED_RR.
+	 * The child already runs with its lower nice value until then */
+	if (prio && SCHED_OTHER != prio->policy) {
+		memset(&param, 0x0, sizeof(param));
+		if (sched_setscheduler(pid, prio->policy, &param) < 0)
+			USB_LOG("FAIL: sched_setscheduler(%d, %d) errno: %d\n", pid, prio->policy, errno);
+	}
+
+	__USB_FUNC_EXIT__ ;
+	return pid;
+}
+
+static void proc_child_unwatch(UmProcChild *child)
+{
+	if (child->handler) {
+		ecore_main_fd_handler_del(child->handler);
+		child->handler = NULL;
+	}
+	if (child->pidfd >= 0) {
+		close(child->pidfd);
+		child->pidfd = -1;
+	}
+}
+
+static void proc_child_exited(pid_t pid, int status)
+{
+	__USB_FUNC_ENTER__ ;
+	UmProcChild **pp = &children;
+	UmProcChild *child = NULL;
+
+	while (*pp) {
+		if ((*pp)->pid == pid) {
+			child = *pp;
+			*pp = child->next;
+			break;
+		}
+		pp = &((*pp)->next);
+	}
+	if (!child) {
+		USB_LOG("Unknown child %d exits with %d\n", pid, status);
+		return;
+	}
+
+	proc_child_unwatch(child);
+	if (child->cb) child->cb(pid, status, child->data);
+	FREE(child);
+	__USB_FUNC_EXIT__ ;
+}
+
+/* Only the children in the table are reaped. Children which libraries fork
+ * in usb-server, such as popups and launched apps, are left to them.
+ * Returns the number of reaped children */
+static int proc_reap()
+{
+	UmProcChild *child = children;
+	pid_t pid;
+	int status;
+	int num = 0;
+
+	while (child) {
+		pid = waitpid(child->pid, &status, WNOHANG);
+		if (0 == pid) {
+			child = child->next;
+			continue;
+		}
+		/* Somebody else reaped it, its status is lost */
+		if (pid < 0) status = -1;
+		proc_child_exited(child->pid, status);
+		num++;
+		/* The callback can spawn children */
+		child = children;
+	}
+	return num;
+}
+
+static Eina_Bool proc_pidfd_cb(void *data, Ecore_Fd_Handler *fd_handler)
+{
+	__USB_FUNC_ENTER__ ;
+	if (ecore_main_fd_handler_active_get(fd_handler, ECORE_FD_READ) == EINA_FALSE)
+		return ECORE_CALLBACK_RENEW;
+	/* The pidfd is readable once the child exits */
+	proc_reap();
+	__USB_FUNC_EXIT__ ;
+	return ECORE_CALLBACK_RENEW;
+}
+
+static Eina_Bool proc_polled_children()
+{
+	UmProcChild *child;
+	for (child = children ; child ; child = child->next) {
+		if (child->pidfd < 0) return EINA_TRUE;
+	}
+	return EINA_FALSE;
+}
+
+static Eina_Bool proc_reap_timer_cb(void *data)
+{
+	proc_reap();
+	if (EINA_TRUE == proc_polled_children()) return ECORE_CALLBACK_RENEW;
+	reap_timer = NULL;
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/* Without pidfds, the children are polled while any of them runs */
+static void proc_child_watch(UmProcChild *child)
+{
+#ifdef SYS_pidfd_open
+	child->pidfd = syscall(SYS_pidfd_open, child->pid, 0);
+	if (child->pidfd >= 0) {
+		child->handler = ecore_main_fd_handler_add(child->pidfd, ECORE_FD_READ,
+								proc_pidfd_cb, NULL, NULL, NULL);
+		if (child->handler) return;
+		USB_LOG("FAIL: ecore_main_fd_handler_add(pidfd %d)\n", child->pid);
+		close(child->pidfd);
+		child->pidfd = -1;
+	}
+#endif
+	if (reap_timer) return;
+	reap_timer = ecore_timer_add(PROC_REAP_POLL, proc_reap_timer_cb, NULL);
+	if (!reap_timer) USB_LOG("FAIL: ecore_timer_add(). Child %d is reaped later\n", child->pid);
+}
+
+int um_proc_init()
+{
+	__USB_FUNC_ENTER__ ;
+	UmProcChild *child;
+
+	if (EINA_TRUE == watching) return 0;
+
+	errno = 0;
+	base_nice = getpriority(PRIO_PROCESS, 0);
+	if (errno != 0) base_nice = 0;
+
+	watching = EINA_TRUE;
+	/* Children of a previous main loop are still reaped */
+	for (child = children ; child ; child = child->next)
+		proc_child_watch(child);
+	proc_reap();
+
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* The main loop goes away. Running children stay in the table without their
+ * callbacks, so that they are reaped once um_proc_init() is called again */
+void um_proc_deinit()
+{
+	__USB_FUNC_ENTER__ ;
+	UmProcChild *child;
+
+	if (EINA_FALSE == watching) return;
+
+	um_proc_flush();
+	proc_reap();
+
+	for (child = children ; child ; child = child->next) {
+		proc_child_unwatch(child);
+		child->cb = NULL;
+		child->data = NULL;
+	}
+
+	if (reap_timer) {
+		ecore_timer_del(reap_timer);
+		reap_timer = NULL;
+	}
+	watching = EINA_FALSE;
+	__USB_FUNC_EXIT__ ;
+}
+
+/* Starts argv[0] (absolute path) without a shell.
+ * If the child watcher is not initialized, this blocks until the child exits */
+pid_t um_proc_spawn(char *const argv[], um_proc_done_cb cb, void *data)
+{
+	return um_proc_spawn_prio(argv, NULL, cb, data);
+}
+
+pid_t um_proc_spawn_prio(char *const argv[], const UmProcPriority *prio,
+						um_proc_done_cb cb, void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	UmProcChild *child = NULL;
+	pid_t pid = -1;
+	int status = -1;
+
+	if (!argv || !argv[0]) return -1;
+
+	pid = proc_spawn_child(argv, prio);
+	um_retvm_if(pid < 0, -1, "FAIL: proc_spawn_child(%s)\n", argv[0]);
+
+	if (EINA_FALSE == watching) {
+		if (waitpid(pid, &status, 0) < 0) status = -1;
+		if (cb) cb(pid, status, data);
+		__USB_FUNC_EXIT__ ;
+		return pid;
+	}
+
+	child = (UmProcChild *)calloc(1, sizeof(UmProcChild));
+	um_retvm_if(!child, pid, "FAIL: calloc(UmProcChild)\n");
+	child->pid = pid;
+	child->pidfd = -1;
+	child->cb = cb;
+	child->data = data;
+	child->next = children;
+	children = child;
+	proc_child_watch(child);
+
+	__USB_FUNC_EXIT__ ;
+	return pid;
+}
+
+static void proc_cmd_done(pid_t pid, int status, void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	UmProcCmd *cmd = (UmProcCmd *)data;
+	if (!cmd) return;
+
+	USB_LOG("The result of %s is %d\n", cmd->cmd, status);
+
+	cmd_head = cmd->next;
+	if (!cmd_head) cmd_tail = NULL;
+	cmd_busy = EINA_FALSE;
+	cmd_pid = -1;
+
+	if (cmd->cb) cmd->cb(pid, status, cmd->data);
+	FREE(cmd);
+
+	proc_cmd_next();
+	__USB_FUNC_EXIT__ ;
+}
+
+static void proc_cmd_next()
+{
+	__USB_FUNC_ENTER__ ;
+	pid_t pid;
+
+	if (cmd_busy || !cmd_head) return;
+
+	cmd_busy = EINA_TRUE;
+	pid = um_proc_spawn(cmd_head->argv, proc_cmd_done, cmd_head);
+	if (pid < 0) {
+		proc_cmd_done(-1, -1, cmd_head);
+		return;
+	}
+	if (EINA_TRUE == watching) cmd_pid = pid;
+	__USB_FUNC_EXIT__ ;
+}
+
+/* Splits cmd on spaces into buf and argv. Returns the number of arguments */
+static int proc_cmd_parse(const char *cmd, char *buf, char *argv[])
+{
+	char *saveptr = NULL;
+	char *token = NULL;
+	int argc = 0;
+
+	snprintf(buf, PROC_CMD_LEN, "%s", cmd);
+	for (token = strtok_r(buf, " ", &saveptr);
+			token && argc < PROC_MAX_ARGS - 1;
+			token = strtok_r(NULL, " ", &saveptr)) {
+		argv[argc++] = token;
+	}
+	argv[argc] = NULL;
+	return argc;
+}
+
+/* Queues a command line such as "/etc/init.d/sdbd start".
+ * Arguments are split on spaces; no shell syntax is supported */
+int um_proc_run_cmd(const char *cmd, um_proc_done_cb cb, void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!cmd) return -1;
+	UmProcCmd *pcmd = NULL;
+
+	pcmd = (UmProcCmd *)calloc(1, sizeof(UmProcCmd));
+	um_retvm_if(!pcmd, -1, "FAIL: calloc(UmProcCmd)\n");
+
+	snprintf(pcmd->cmd, PROC_CMD_LEN, "%s", cmd);
+	if (0 == proc_cmd_parse(cmd, pcmd->buf, pcmd->argv)) {
+		USB_LOG("ERROR: empty command\n");
+		FREE(pcmd);
+		return -1;
+	}
+	pcmd->cb = cb;
+	pcmd->data = data;
+
+	if (cmd_tail) cmd_tail->next = pcmd;
+	else cmd_head = pcmd;
+	cmd_tail = pcmd;
+
+	proc_cmd_next();
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* Starts a command line right away, without waiting for the queued commands */
+pid_t um_proc_spawn_cmd(const char *cmd, const UmProcPriority *prio,
+						um_proc_done_cb cb, void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!cmd) return -1;
+	char buf[PROC_CMD_LEN];
+	char *argv[PROC_MAX_ARGS];
+	pid_t pid;
+
+	um_retvm_if(0 == proc_cmd_parse(cmd, buf, argv), -1, "ERROR: empty command\n");
+	pid = um_proc_spawn_prio(argv, prio, cb, data);
+	__USB_FUNC_EXIT__ ;
+	return pid;
+}
+
+/* The callback of the child is not called any more. The child is still reaped */
+void um_proc_detach(pid_t pid)
+{
+	UmProcChild *child = children;
+	while (child) {
+		if (child->pid == pid) {
+			child->cb = NULL;
+			child->data = NULL;
+			return;
+		}
+		child = child->next;
+	}
+}
+
+/* Runs the queued commands to completion, blocking.
+ * Used before the main loop goes away so that stop commands are not lost */
+void um_proc_flush()
+{
+	__USB_FUNC_ENTER__ ;
+	pid_t pid;
+	int status;
+
+	while (cmd_busy && cmd_pid > 0) {
+		pid = cmd_pid;
+		if (waitpid(pid, &status, 0) < 0) status = -1;
+		proc_child_exited(pid, status);
+	}
+	__USB_FUNC_EXIT__ ;
+}
+
+/* EINA_FALSE if um_proc_spawn() waits for the child */
+Eina_Bool um_proc_watching()
+{
+	return watching;
+}
+
+/* The nice value of usb-server outside mode changes */
+int um_proc_base_nice()
+{
+	return base_nice;
+}
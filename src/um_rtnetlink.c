@@ -0,0 +1,318 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_rtnetlink.h"
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+typedef struct _UmRtnlMsg {
+	char			buf[RTNL_MSG_LEN];
+	int				errIgnored;		/* errno which means the request is already applied */
+	int				error;
+	Eina_Bool		acked;
+} UmRtnlMsg;
+
+typedef struct _UmRtnlBatch {
+	UmRtnlMsg		msgs[RTNL_MAX_MSGS];
+	int				numMsgs;
+	int				numAcked;
+	unsigned int	seq;
+} UmRtnlBatch;
+
+static unsigned int rtnlSeq = 0;
+
+/* The batch which waits for its acks. There is one at a time */
+static UmRtnlBatch sentBatch;
+static int sentSock = -1;
+static Ecore_Fd_Handler *sentHandler = NULL;
+static um_rtnl_done_cb sentCb = NULL;
+static void *sentData = NULL;
+
+static struct nlmsghdr *rtnl_msg_new(UmRtnlBatch *batch, int type, int flags, int len, int errIgnored)
+{
+	UmRtnlMsg *msg = NULL;
+	struct nlmsghdr *nlh = NULL;
+
+	um_retvm_if(batch->numMsgs >= RTNL_MAX_MSGS, NULL, "FAIL: too many rtnetlink messages\n");
+	msg = &(batch->msgs[batch->numMsgs]);
+	memset(msg, 0x0, sizeof(UmRtnlMsg));
+	msg->errIgnored = errIgnored;
+
+	nlh = (struct nlmsghdr *)msg->buf;
+	nlh->nlmsg_len = NLMSG_LENGTH(len);
+	nlh->nlmsg_type = type;
+	nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+	nlh->nlmsg_seq = batch->seq + batch->numMsgs;
+	batch->numMsgs++;
+	return nlh;
+}
+
+static int rtnl_attr_add(struct nlmsghdr *nlh, int type, const void *data, int len)
+{
+	struct rtattr *rta = NULL;
+	int rtaLen = RTA_LENGTH(len);
+
+	um_retvm_if(NLMSG_ALIGN(nlh->nlmsg_len) + RTA_ALIGN(rtaLen) > RTNL_MSG_LEN, -1,
+						"FAIL: rtnetlink message is too long\n");
+	rta = (struct rtattr *)((char *)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = rtaLen;
+	memcpy(RTA_DATA(rta), data, len);
+	nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + RTA_ALIGN(rtaLen);
+	return 0;
+}
+
+static int rtnl_link_set(UmRtnlBatch *batch, int ifindex, Eina_Bool up)
+{
+	struct nlmsghdr *nlh = NULL;
+	struct ifinfomsg *ifi = NULL;
+
+	nlh = rtnl_msg_new(batch, RTM_NEWLINK, 0, sizeof(struct ifinfomsg), 0);
+	if (!nlh) return -1;
+	ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+	ifi->ifi_family = AF_UNSPEC;
+	ifi->ifi_index = ifindex;
+	ifi->ifi_change = IFF_UP;
+	ifi->ifi_flags = up ? IFF_UP : 0;
+	return 0;
+}
+
+static int rtnl_addr(UmRtnlBatch *batch, int ifindex, struct in_addr *addr, int prefixLen, Eina_Bool add)
+{
+	struct nlmsghdr *nlh = NULL;
+	struct ifaddrmsg *ifa = NULL;
+
+	if (add)
+		nlh = rtnl_msg_new(batch, RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL, sizeof(struct ifaddrmsg), EEXIST);
+	else
+		nlh = rtnl_msg_new(batch, RTM_DELADDR, 0, sizeof(struct ifaddrmsg), EADDRNOTAVAIL);
+	if (!nlh) return -1;
+	ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
+	ifa->ifa_family = AF_INET;
+	ifa->ifa_prefixlen = prefixLen;
+	ifa->ifa_index = ifindex;
+	ifa->ifa_scope = RT_SCOPE_UNIVERSE;
+	if (0 != rtnl_attr_add(nlh, IFA_LOCAL, addr, sizeof(*addr))) return -1;
+	return rtnl_attr_add(nlh, IFA_ADDRESS, addr, sizeof(*addr));
+}
+
+/* The address adds the same route already, so EEXIST is the usual answer */
+static int rtnl_route_add(UmRtnlBatch *batch, int ifindex, struct in_addr *net, int prefixLen)
+{
+	struct nlmsghdr *nlh = NULL;
+	struct rtmsg *rtm = NULL;
+
+	nlh = rtnl_msg_new(batch, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, sizeof(struct rtmsg), EEXIST);
+	if (!nlh) return -1;
+	rtm = (struct rtmsg *)NLMSG_DATA(nlh);
+	rtm->rtm_family = AF_INET;
+	rtm->rtm_dst_len = prefixLen;
+	rtm->rtm_table = RT_TABLE_MAIN;
+	rtm->rtm_protocol = RTPROT_BOOT;
+	rtm->rtm_scope = RT_SCOPE_LINK;
+	rtm->rtm_type = RTN_UNICAST;
+	if (0 != rtnl_attr_add(nlh, RTA_DST, net, sizeof(*net))) return -1;
+	return rtnl_attr_add(nlh, RTA_OIF, &ifindex, sizeof(ifindex));
+}
+
+/* Reads the acks which are there. Returns -1 on failure */
+static int rtnl_recv_acks(int sock, UmRtnlBatch *batch)
+{
+	__USB_FUNC_ENTER__ ;
+	char buf[RTNL_RECV_BUF_LEN];
+	struct nlmsghdr *nlh = NULL;
+	struct nlmsgerr *err = NULL;
+	unsigned int idx;
+	int len;
+
+	while (batch->numAcked < batch->numMsgs) {
+		len = recv(sock, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (EINTR == errno) continue;
+			if (EAGAIN == errno || EWOULDBLOCK == errno) break;
+			USB_LOG("FAIL: recv(rtnetlink) errno: %d\n", errno);
+			return -1;
+		}
+		for (nlh = (struct nlmsghdr *)buf ; NLMSG_OK(nlh, len) ; nlh = NLMSG_NEXT(nlh, len)) {
+			if (NLMSG_ERROR != nlh->nlmsg_type) continue;
+			idx = nlh->nlmsg_seq - batch->seq;
+			if (idx >= batch->numMsgs || batch->msgs[idx].acked) continue;
+			err = (struct nlmsgerr *)NLMSG_DATA(nlh);
+			batch->msgs[idx].acked = EINA_TRUE;
+			batch->msgs[idx].error = -(err->error);
+			batch->numAcked++;
+		}
+	}
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+static int rtnl_batch_result(UmRtnlBatch *batch)
+{
+	int ret = 0;
+	int i;
+
+	for (i = 0 ; i < batch->numMsgs ; i++) {
+		if (0 == batch->msgs[i].error || batch->msgs[i].errIgnored == batch->msgs[i].error)
+			continue;
+		USB_LOG("FAIL: rtnetlink request %d(type %d) errno: %d\n", i,
+					((struct nlmsghdr *)batch->msgs[i].buf)->nlmsg_type, batch->msgs[i].error);
+		ret = -1;
+	}
+	return ret;
+}
+
+static Eina_Bool rtnl_ack_cb(void *data, Ecore_Fd_Handler *fd_handler)
+{
+	__USB_FUNC_ENTER__ ;
+	um_rtnl_done_cb cb = sentCb;
+	void *cbData = sentData;
+	int ret = -1;
+
+	ret = rtnl_recv_acks(sentSock, &sentBatch);
+	if (0 == ret && sentBatch.numAcked < sentBatch.numMsgs) {
+		__USB_FUNC_EXIT__ ;
+		return ECORE_CALLBACK_RENEW;
+	}
+	if (0 == ret)
+		ret = rtnl_batch_result(&sentBatch);
+
+	/* Deletes the handler */
+	um_rtnl_cancel();
+	if (cb) cb(ret, cbData);
+	__USB_FUNC_EXIT__ ;
+	return ECORE_CALLBACK_RENEW;
+}
+
+/* The acks are read from the main loop */
+static int rtnl_batch_send(UmRtnlBatch *batch, um_rtnl_done_cb cb, void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	struct sockaddr_nl addr;
+	struct iovec iov[RTNL_MAX_MSGS];
+	struct msghdr msg;
+	int sock;
+	int i;
+
+	um_rtnl_cancel();
+	sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+	um_retvm_if(sock < 0, -1, "FAIL: socket(NETLINK_ROUTE) errno: %d\n", errno);
+
+	memset(&addr, 0x0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	for (i = 0 ; i < batch->numMsgs ; i++) {
+		iov[i].iov_base = batch->msgs[i].buf;
+		iov[i].iov_len = NLMSG_ALIGN(((struct nlmsghdr *)batch->msgs[i].buf)->nlmsg_len);
+	}
+	memset(&msg, 0x0, sizeof(msg));
+	msg.msg_name = &addr;
+	msg.msg_namelen = sizeof(addr);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = batch->numMsgs;
+
+	if (sendmsg(sock, &msg, 0) < 0) {
+		USB_LOG("FAIL: sendmsg(rtnetlink) errno: %d\n", errno);
+		close(sock);
+		return -1;
+	}
+
+	sentHandler = ecore_main_fd_handler_add(sock, ECORE_FD_READ, rtnl_ack_cb, NULL, NULL, NULL);
+	if (!sentHandler) {
+		USB_LOG("FAIL: ecore_main_fd_handler_add(rtnetlink)\n");
+		close(sock);
+		return -1;
+	}
+	memcpy(&sentBatch, batch, sizeof(UmRtnlBatch));
+	sentSock = sock;
+	sentCb = cb;
+	sentData = data;
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+static int rtnl_batch_init(UmRtnlBatch *batch, const char *ifname, int *ifindex)
+{
+	memset(batch, 0x0, sizeof(UmRtnlBatch));
+	batch->seq = rtnlSeq;
+	rtnlSeq += RTNL_MAX_MSGS;
+
+	*ifindex = if_nametoindex(ifname);
+	um_retvm_if(0 == *ifindex, -1, "FAIL: if_nametoindex(%s) errno: %d\n", ifname, errno);
+	return 0;
+}
+
+int um_rtnl_net_up(const char *ifname, const char *addr, const char *net, int prefixLen,
+					um_rtnl_done_cb cb, void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ifname || !addr || !net) return -1;
+	UmRtnlBatch batch;
+	struct in_addr inAddr;
+	struct in_addr inNet;
+	int ifindex;
+
+	um_retvm_if(1 != inet_pton(AF_INET, addr, &inAddr), -1, "FAIL: inet_pton(%s)\n", addr);
+	um_retvm_if(1 != inet_pton(AF_INET, net, &inNet), -1, "FAIL: inet_pton(%s)\n", net);
+	if (0 != rtnl_batch_init(&batch, ifname, &ifindex)) return -1;
+
+	/* Requests are handled in order, so the link is up before the route is added */
+	if (0 != rtnl_link_set(&batch, ifindex, EINA_TRUE)) return -1;
+	if (0 != rtnl_addr(&batch, ifindex, &inAddr, prefixLen, EINA_TRUE)) return -1;
+	if (0 != rtnl_route_add(&batch, ifindex, &inNet, prefixLen)) return -1;
+
+	__USB_FUNC_EXIT__ ;
+	return rtnl_batch_send(&batch, cb, data);
+}
+
+int um_rtnl_net_down(const char *ifname, const char *addr, int prefixLen,
+					um_rtnl_done_cb cb, void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ifname || !addr) return -1;
+	UmRtnlBatch batch;
+	struct in_addr inAddr;
+	int ifindex;
+
+	um_retvm_if(1 != inet_pton(AF_INET, addr, &inAddr), -1, "FAIL: inet_pton(%s)\n", addr);
+	if (0 != rtnl_batch_init(&batch, ifname, &ifindex)) return -1;
+
+	if (0 != rtnl_addr(&batch, ifindex, &inAddr, prefixLen, EINA_FALSE)) return -1;
+	if (0 != rtnl_link_set(&batch, ifindex, EINA_FALSE)) return -1;
+
+	__USB_FUNC_EXIT__ ;
+	return rtnl_batch_send(&batch, cb, data);
+}
+
+void um_rtnl_cancel()
+{
+	if (sentHandler) {
+		ecore_main_fd_handler_del(sentHandler);
+		sentHandler = NULL;
+	}
+	if (sentSock >= 0) {
+		close(sentSock);
+		sentSock = -1;
+	}
+	sentCb = NULL;
+	sentData = NULL;
+}
@@ -0,0 +1,196 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_udc_monitor.h"
+#include <dirent.h>
+#include <fcntl.h>
+
+static um_udc_done_cb udcDone = NULL;
+
+int um_udc_name(char *name, int len)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!name || len <= 0) return -1;
+	struct dirent *entry = NULL;
+	DIR *dir = NULL;
+	int ret = -1;
+
+	dir = opendir(UDC_CLASS_PATH);
+	um_retvm_if(!dir, -1, "FAIL: opendir(%s) errno: %d\n", UDC_CLASS_PATH, errno);
+	while ((entry = readdir(dir)) != NULL) {
+		if ('.' == entry->d_name[0]) continue;
+		snprintf(name, len, "%s", entry->d_name);
+		ret = 0;
+		break;
+	}
+	closedir(dir);
+	__USB_FUNC_EXIT__ ;
+	return ret;
+}
+
+static int udc_state_open()
+{
+	char name[UDC_PATH_LEN];
+	char path[UDC_PATH_LEN * 2];
+	int fd = -1;
+
+	if (um_udc_name(name, sizeof(name)) < 0) return -1;
+	snprintf(path, sizeof(path), "%s/%s/state", UDC_CLASS_PATH, name);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	um_retvm_if(fd < 0, -1, "FAIL: open(%s) errno: %d\n", path, errno);
+	return fd;
+}
+
+/* sysfs wakes up pollers with POLLPRI, and the attribute must be read again from offset 0 */
+static Eina_Bool udc_state_configured(UmMainData *ad)
+{
+	char buf[UDC_STATE_BUF_LEN];
+	int len;
+
+	len = pread(ad->udcStateFd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0) return EINA_FALSE;
+	if ('\n' == buf[len - 1]) len--;
+	buf[len] = '\0';
+	return strcmp(buf, UDC_STATE_CONFIGURED) ? EINA_FALSE : EINA_TRUE;
+}
+
+static void udc_watch_done(UmMainData *ad, Eina_Bool configured)
+{
+	__USB_FUNC_ENTER__ ;
+	UmEnumReport *report = &(ad->enumReport);
+	double elapsed = ecore_time_get() - report->start;
+	um_udc_done_cb cb = udcDone;
+	int ret = -1;
+
+	um_udc_watch_stop(ad);
+
+	if (EINA_TRUE == configured && report->start < 0) {
+		report->last = -1;
+		USB_LOG("Configured by the host, the time since the plug is not known\n");
+	} else if (EINA_TRUE == configured) {
+		report->last = elapsed;
+		report->sum += elapsed;
+		if (elapsed > report->max) report->max = elapsed;
+		report->numConfigured++;
+		USB_LOG("Configured by the host in %.3f ms (%u times, %.3f ms on average, %.3f ms at most)\n",
+						elapsed * 1000, report->numConfigured,
+						report->sum * 1000 / report->numConfigured, report->max * 1000);
+	} else {
+		report->last = -1;
+		report->numTimeouts++;
+		USB_LOG("ERROR: Not configured by the host in %.1f s (%u times)\n",
+						UDC_CONFIGURED_TIMEOUT, report->numTimeouts);
+	}
+
+	ret = vconf_set_int(VCONFKEY_USB_CONFIGURED_TIME,
+						(report->last < 0) ? -1 : (int)(report->last * 1000));
+	if (0 != ret) USB_LOG("FAIL: vconf_set_int(VCONFKEY_USB_CONFIGURED_TIME)\n");
+
+	if (cb) cb(ad, configured);
+	__USB_FUNC_EXIT__ ;
+}
+
+static Eina_Bool udc_state_cb(void *data, Ecore_Fd_Handler *fd_handler)
+{
+	UmMainData *ad = (UmMainData *)data;
+	if (!ad) return ECORE_CALLBACK_RENEW;
+
+	if (EINA_TRUE == udc_state_configured(ad)) udc_watch_done(ad, EINA_TRUE);
+	return ECORE_CALLBACK_RENEW;
+}
+
+static Eina_Bool udc_poll_cb(void *data)
+{
+	UmMainData *ad = (UmMainData *)data;
+	if (!ad) return ECORE_CALLBACK_CANCEL;
+
+	if (EINA_TRUE == udc_state_configured(ad)) {
+		ad->udcTimer = NULL;
+		udc_watch_done(ad, EINA_TRUE);
+		return ECORE_CALLBACK_CANCEL;
+	}
+	if (ecore_time_get() >= ad->udcDeadline) {
+		ad->udcTimer = NULL;
+		udc_watch_done(ad, EINA_FALSE);
+		return ECORE_CALLBACK_CANCEL;
+	}
+	return ECORE_CALLBACK_RENEW;
+}
+
+int um_udc_watch_start(UmMainData *ad, um_udc_done_cb cb)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return -1;
+
+	um_udc_watch_stop(ad);
+	ad->udcStateFd = udc_state_open();
+	um_retvm_if(ad->udcStateFd < 0, -1, "FAIL: No UDC state to watch\n");
+	udcDone = cb;
+	ad->udcDeadline = ecore_time_get() + UDC_CONFIGURED_TIMEOUT;
+
+	if (EINA_TRUE == udc_state_configured(ad)) {
+		udc_watch_done(ad, EINA_TRUE);
+		__USB_FUNC_EXIT__ ;
+		return 0;
+	}
+
+	ad->udcFdHandler = ecore_main_fd_handler_add(ad->udcStateFd, ECORE_FD_ERROR,
+							udc_state_cb, ad, NULL, NULL);
+	if (!ad->udcFdHandler) USB_LOG("FAIL: ecore_main_fd_handler_add(UDC state)\n");
+
+	/* Also checks the deadline */
+	ad->udcTimer = ecore_timer_add(UDC_POLL_INTERVAL, udc_poll_cb, ad);
+	if (!ad->udcTimer) {
+		USB_LOG("FAIL: ecore_timer_add(UDC state)\n");
+		um_udc_watch_stop(ad);
+		return -1;
+	}
+
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+void um_udc_watch_stop(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return;
+
+	if (ad->udcTimer) {
+		ecore_timer_del(ad->udcTimer);
+		ad->udcTimer = NULL;
+	}
+	if (ad->udcFdHandler) {
+		ecore_main_fd_handler_del(ad->udcFdHandler);
+		ad->udcFdHandler = NULL;
+	}
+	if (ad->udcStateFd >= 0) {
+		close(ad->udcStateFd);
+		ad->udcStateFd = -1;
+	}
+	udcDone = NULL;
+	__USB_FUNC_EXIT__ ;
+}
+
+Eina_Bool um_udc_watching(UmMainData *ad)
+{
+	if (!ad) return EINA_FALSE;
+	return (ad->udcStateFd >= 0) ? EINA_TRUE : EINA_FALSE;
+}
@@ -0,0 +1,170 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_uevent_listener.h"
+#include <linux/netlink.h>
+
+static um_uevent_acc_cb accEvent = NULL;
+
+/* A uevent is "<action>@<devpath>" followed by "KEY=value" strings,
+ * each of them terminated by NUL */
+static void uevent_parse(UmMainData *ad, char *buf, int len)
+{
+	__USB_FUNC_ENTER__ ;
+	char *key = NULL;
+	char *devpath = NULL;
+	char *accessory = NULL;
+	unsigned long long seqnum = 0;
+	Eina_Bool hasSeqnum = EINA_FALSE;
+	int off = 0;
+
+	while (off < len) {
+		key = buf + off;
+		off += strlen(key) + 1;
+		if (!strncmp(key, "DEVPATH=", 8)) {
+			devpath = key + 8;
+		} else if (!strncmp(key, "ACCESSORY=", 10)) {
+			accessory = key + 10;
+		} else if (!strncmp(key, "SEQNUM=", 7)) {
+			seqnum = strtoull(key + 7, NULL, 10);
+			hasSeqnum = EINA_TRUE;
+		}
+	}
+
+	if (!devpath || strcmp(devpath, USB_ACCESSORY_DEVPATH)) return;
+	if (!accessory) return;
+
+	/* Events are delivered in order, so an older one is a duplicate */
+	if (hasSeqnum) {
+		if (ad->ueventSeqnum != 0 && seqnum <= ad->ueventSeqnum) {
+			USB_LOG("Stale uevent %llu (last: %llu) is dropped\n", seqnum, ad->ueventSeqnum);
+			return;
+		}
+		ad->ueventSeqnum = seqnum;
+	}
+
+	USB_LOG("uevent %llu: ACCESSORY=%s\n", seqnum, accessory);
+	if (!strcmp(accessory, "START")) {
+		if (accEvent) accEvent(ad, UEVENT_ACCESSORY_START);
+	} else if (!strcmp(accessory, "STOP")) {
+		if (accEvent) accEvent(ad, UEVENT_ACCESSORY_STOP);
+	}
+	__USB_FUNC_EXIT__ ;
+}
+
+static Eina_Bool uevent_cb(void *data, Ecore_Fd_Handler *fd_handler)
+{
+	__USB_FUNC_ENTER__ ;
+	UmMainData *ad = (UmMainData *)data;
+	if (!ad) return ECORE_CALLBACK_RENEW;
+	char buf[UEVENT_BUF_LEN];
+	struct sockaddr_nl addr;
+	struct iovec iov;
+	struct msghdr msg;
+	int len;
+
+	if (ecore_main_fd_handler_active_get(fd_handler, ECORE_FD_READ) == EINA_FALSE)
+		return ECORE_CALLBACK_RENEW;
+
+	while (1) {
+		memset(&msg, 0x0, sizeof(msg));
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf) - 1;
+		msg.msg_name = &addr;
+		msg.msg_namelen = sizeof(addr);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		len = recvmsg(ad->ueventSock, &msg, 0);
+		if (len < 0) {
+			if (EINTR == errno) continue;
+			if (EAGAIN != errno && EWOULDBLOCK != errno)
+				USB_LOG("FAIL: recvmsg(uevent) errno: %d\n", errno);
+			break;
+		}
+		/* Only the kernel is trusted */
+		if (addr.nl_pid != 0) continue;
+		if (msg.msg_flags & MSG_TRUNC) {
+			USB_LOG("uevent is truncated\n");
+			continue;
+		}
+		buf[len] = '\0';
+		uevent_parse(ad, buf, len);
+	}
+	__USB_FUNC_EXIT__ ;
+	return ECORE_CALLBACK_RENEW;
+}
+
+int um_uevent_listener_start(UmMainData *ad, um_uevent_acc_cb cb)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return -1;
+	struct sockaddr_nl addr;
+	int rcvbuf = UEVENT_RCVBUF_LEN;
+	int sock;
+
+	accEvent = cb;
+
+	sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	um_retvm_if(sock < 0, -1, "FAIL: socket(NETLINK_KOBJECT_UEVENT) errno: %d\n", errno);
+
+	if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0)
+		USB_LOG("FAIL: setsockopt(SO_RCVBUF)\n");
+
+	/* Group 1 is the kernel multicast group, which udev listens to as well */
+	memset(&addr, 0x0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_pid = 0;
+	addr.nl_groups = 1;
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		USB_LOG("FAIL: bind(NETLINK_KOBJECT_UEVENT) errno: %d\n", errno);
+		close(sock);
+		return -1;
+	}
+
+	ad->ueventFdHandler = ecore_main_fd_handler_add(sock, ECORE_FD_READ,
+							uevent_cb, ad, NULL, NULL);
+	if (!ad->ueventFdHandler) {
+		USB_LOG("FAIL: ecore_main_fd_handler_add(uevent)\n");
+		close(sock);
+		return -1;
+	}
+	ad->ueventSock = sock;
+
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+void um_uevent_listener_stop(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return;
+
+	if (ad->ueventFdHandler) {
+		ecore_main_fd_handler_del(ad->ueventFdHandler);
+		ad->ueventFdHandler = NULL;
+	}
+	if (ad->ueventSock >= 0) {
+		close(ad->ueventSock);
+		ad->ueventSock = -1;
+	}
+	__USB_FUNC_EXIT__ ;
+}
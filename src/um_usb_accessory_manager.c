@@ -25,6 +25,38 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 
+static void usbAccessoryReset(UsbAccessory *usbAcc)
+{
+	if (!usbAcc) return;
+	usbAcc->manufacturer = NULL;
+	usbAcc->model = NULL;
+	usbAcc->description = NULL;
+	usbAcc->version = NULL;
+	usbAcc->uri = NULL;
+	usbAcc->serial = NULL;
+	memset(usbAcc->len, 0x0, sizeof(usbAcc->len));
+	usbAcc->arenaUsed = 0;
+}
+
+/* The kernel copies the element straight into the arena */
+static char *usbAccessoryRead(UsbAccessory *usbAcc, int acc, unsigned long request, ACC_ELEMENT element)
+{
+	char *str = usbAcc->arena + usbAcc->arenaUsed;
+
+	if (sizeof(usbAcc->arena) - usbAcc->arenaUsed < ACC_ELEMENT_LEN) {
+		USB_LOG("FAIL: No room for the accessory element %d\n", element);
+		return NULL;
+	}
+	if (ioctl(acc, request, str) < 0) {
+		USB_LOG("FAIL: ioctl(%d) for the accessory element %d\n", errno, element);
+		str[0] = '\0';
+	}
+	usbAcc->len[element] = strnlen(str, ACC_ELEMENT_LEN - 1);
+	str[usbAcc->len[element]] = '\0';
+	usbAcc->arenaUsed += usbAcc->len[element] + 1;
+	return str;
+}
+
 int getAccessoryInfo(UsbAccessory *usbAcc)
 {
 	__USB_FUNC_ENTER__;
@@ -33,19 +65,14 @@ int getAccessoryInfo(UsbAccessory *usbAcc)
 	int acc = open(USB_ACCESSORY_NODE, O_RDONLY);
 	um_retvm_if(acc < 0, -1, "FAIL: open(USB_ACCESSORY_NODE, O_RDONLY)");
 
-	char buf[ACC_ELEMENT_LEN];
-	ioctl(acc, USB_ACCESSORY_GET_MANUFACTURER, buf);
-	usbAcc->manufacturer = strdup(buf);
-	ioctl(acc, USB_ACCESSORY_GET_MODEL, buf);
-	usbAcc->model = strdup(buf);
-	ioctl(acc, USB_ACCESSORY_GET_DESCRIPTION, buf);
-	usbAcc->description = strdup(buf);
-	ioctl(acc, USB_ACCESSORY_GET_VERSION, buf);
-	usbAcc->version = strdup(buf);
-	ioctl(acc, USB_ACCESSORY_GET_URI, buf);
-	usbAcc->uri = strdup(buf);
-	ioctl(acc, USB_ACCESSORY_GET_SERIAL, buf);
-	usbAcc->serial = strdup(buf);
+	/* The previous accessory is dropped, if any */
+	usbAccessoryReset(usbAcc);
+	usbAcc->manufacturer = usbAccessoryRead(usbAcc, acc, USB_ACCESSORY_GET_MANUFACTURER, ACC_MANUFACTURER);
+	usbAcc->model = usbAccessoryRead(usbAcc, acc, USB_ACCESSORY_GET_MODEL, ACC_MODEL);
+	usbAcc->description = usbAccessoryRead(usbAcc, acc, USB_ACCESSORY_GET_DESCRIPTION, ACC_DESCRIPTION);
+	usbAcc->version = usbAccessoryRead(usbAcc, acc, USB_ACCESSORY_GET_VERSION, ACC_VERSION);
+	usbAcc->uri = usbAccessoryRead(usbAcc, acc, USB_ACCESSORY_GET_URI, ACC_URI);
+	usbAcc->serial = usbAccessoryRead(usbAcc, acc, USB_ACCESSORY_GET_SERIAL, ACC_SERIAL);
 
 	close(acc);
 
@@ -53,6 +80,88 @@ int getAccessoryInfo(UsbAccessory *usbAcc)
 	return 0;
 }
 
+UmAccInfoBlob *accInfoBlobNew(UsbAccessory *usbAcc, unsigned int generation)
+{
+	__USB_FUNC_ENTER__;
+	UmAccInfoBlob *blob = NULL;
+	char *src[ACC_INFO_NUM] = { NULL, };
+	int len[ACC_INFO_NUM];
+	int total = 0;
+	char *p;
+	int i;
+
+	if (usbAcc) {
+		src[ACC_MANUFACTURER] = usbAcc->manufacturer;
+		src[ACC_MODEL] = usbAcc->model;
+		src[ACC_DESCRIPTION] = usbAcc->description;
+		src[ACC_VERSION] = usbAcc->version;
+		src[ACC_URI] = usbAcc->uri;
+		src[ACC_SERIAL] = usbAcc->serial;
+	}
+	for (i = 0 ; i < ACC_INFO_NUM ; i++) {
+		if (src[i]) {
+			len[i] = usbAcc->len[i];
+		} else {
+			src[i] = "";
+			len[i] = 0;
+		}
+		total += len[i];
+	}
+
+	/* The text and the fields each need the strings and ACC_INFO_NUM separators */
+	blob = (UmAccInfoBlob *)malloc(sizeof(UmAccInfoBlob) + 2 * (total + ACC_INFO_NUM));
+	um_retvm_if(!blob, NULL, "FAIL: malloc(UmAccInfoBlob)");
+	blob->refCount = 1;
+	blob->generation = generation;
+	blob->text = blob->data;
+	blob->textLen = total + ACC_INFO_NUM - 1;
+
+	p = blob->text;
+	for (i = 0 ; i < ACC_INFO_NUM ; i++) {
+		memcpy(p, src[i], len[i]);
+		p += len[i];
+		*p++ = (i < ACC_INFO_NUM - 1) ? '|' : '\0';
+	}
+	for (i = 0 ; i < ACC_INFO_NUM ; i++) {
+		blob->fields[i] = p;
+		memcpy(p, src[i], len[i]);
+		p += len[i];
+		*p++ = '\0';
+	}
+
+	__USB_FUNC_EXIT__;
+	return blob;
+}
+
+UmAccInfoBlob *accInfoBlobRef(UmAccInfoBlob *blob)
+{
+	if (blob) blob->refCount++;
+	return blob;
+}
+
+void accInfoBlobUnref(UmAccInfoBlob *blob)
+{
+	if (!blob) return;
+	if (--(blob->refCount) > 0) return;
+	FREE(blob);
+}
+
+/* Replaces the serialized accessory information.
+ * IPC answers which are not sent yet keep the previous one */
+static void accInfoUpdate(UmMainData *ad, UsbAccessory *usbAcc)
+{
+	__USB_FUNC_ENTER__;
+	UmAccInfoBlob *blob = NULL;
+
+	ad->accInfoGeneration++;
+	blob = accInfoBlobNew(usbAcc, ad->accInfoGeneration);
+	um_retm_if(!blob, "FAIL: accInfoBlobNew()");
+	accInfoBlobUnref(ad->accInfo);
+	ad->accInfo = blob;
+	USB_LOG("Accessory information generation: %u\n", ad->accInfoGeneration);
+	__USB_FUNC_EXIT__;
+}
+
 int accessoryAttached(UmMainData *ad)
 {
 	__USB_FUNC_ENTER__;
@@ -70,10 +179,11 @@ int connectAccessory(UmMainData *ad)
 	ret = getAccessoryInfo(ad->usbAcc);
 	um_retvm_if(0 != ret, -1, "FAIL: getAccessoryInfo(ad->usbAcc)");
 	getCurrentAccessory(ad);
+	accInfoUpdate(ad, ad->usbAcc);
 
 	/* Change usb mode to accessory mode */
-	ret = vconf_set_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, SETTING_USB_ACCESSORY_MODE);
-	um_retvm_if(0 != ret, -1, "FAIL: vconf_set_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT)");
+	ret = um_event_mode_request(ad, SETTING_USB_ACCESSORY_MODE);
+	um_retvm_if(0 != ret, -1, "FAIL: um_event_mode_request(SETTING_USB_ACCESSORY_MODE)");
 	
 	ret = accessoryAttached(ad);
 	um_retvm_if(0 > ret, -1, "FAIL: accessoryAttached(ad);");
@@ -165,12 +275,7 @@ static int usbAccessoryRelease(UmMainData *ad)
 	__USB_FUNC_ENTER__;
 	if (!ad) return -1;
 	if (ad->usbAcc == NULL) return -1;
-	FREE(ad->usbAcc->manufacturer);
-	FREE(ad->usbAcc->version);
-	FREE(ad->usbAcc->description);
-	FREE(ad->usbAcc->model);
-	FREE(ad->usbAcc->uri);
-	FREE(ad->usbAcc->serial);
+	usbAccessoryReset(ad->usbAcc);
 	FREE(ad->permittedPkgForAcc);
 
 	__USB_FUNC_EXIT__;
@@ -182,13 +287,9 @@ void umAccInfoInit(UmMainData *ad)
 	__USB_FUNC_ENTER__;
 	if (!ad) return ;
 	if (ad->usbAcc == NULL) return;
-	ad->usbAcc->manufacturer = NULL;
-	ad->usbAcc->version = NULL;
-	ad->usbAcc->description = NULL;
-	ad->usbAcc->model = NULL;
-	ad->usbAcc->uri = NULL;
-	ad->usbAcc->serial = NULL;
+	usbAccessoryReset(ad->usbAcc);
 	ad->permittedPkgForAcc = NULL;
+	accInfoUpdate(ad, NULL);
 
 	__USB_FUNC_EXIT__;
 }
@@ -198,6 +299,7 @@ int disconnectAccessory(UmMainData *ad)
 	__USB_FUNC_ENTER__;
 	if (!ad) return -1;
 	usbAccessoryRelease(ad);
+	accInfoUpdate(ad, NULL);
 	__USB_FUNC_EXIT__;
 	return 0;
 }
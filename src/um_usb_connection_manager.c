@@ -20,12 +20,20 @@
  */
 
 #include "um_usb_connection_manager.h"
+#include <signal.h>
+#include <sys/resource.h>
+
+static UmTransition transition;
+
+static int mode_transition_start(UmMainData *ad, int mode);
+static int mode_transition_clean(UmMainData *ad, int mode, int other);
 
 int call_cmd(char* cmd)
 {
 	__USB_FUNC_ENTER__ ;
-	int ret = system(cmd);
-	USB_LOG("The result of %s is %d\n",cmd, ret);
+	/* The command is queued and its result is logged when it exits */
+	int ret = um_proc_run_cmd(cmd, NULL, NULL);
+	if (0 != ret) USB_LOG("FAIL: um_proc_run_cmd(%s)\n", cmd);
 	__USB_FUNC_EXIT__ ;
 	return ret;
 }
@@ -38,20 +46,25 @@ int connectUsb(UmMainData *ad)
 	int mh_status = -1;
 	int usbSelMode = -1;
 
+	if (ad->stagedMode >= 0) {
+		USB_LOG("Kernel mode %d was staged\n", ad->stagedMode);
+		ad->stagedMode = -1;
+	}
+
 	/* If the mobile hotspot is on, USB-setting changes USB mode to mobile hotspot */
-	mh_status = check_mobile_hotspot_status();
+	mh_status = check_mobile_hotspot_status(ad);
 	if ((mh_status >= 0) && (mh_status & VCONFKEY_MOBILE_HOTSPOT_MODE_USB))
 	{
 		USB_LOG("Mobile hotspot is on\n");
-		ret = vconf_set_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, SETTING_USB_MOBILE_HOTSPOT);
-		um_retvm_if (0 != ret, -1, "FAIL: vconf_set_int(VCONF_SETAPPL_USB_SEL_MODE_INT)\n");
+		ret = um_event_mode_request(ad, SETTING_USB_MOBILE_HOTSPOT);
+		um_retvm_if (0 != ret, -1, "FAIL: um_event_mode_request(SETTING_USB_MOBILE_HOTSPOT)\n");
 		__USB_FUNC_EXIT__ ;
 		return 0;
 	} else {
 		USB_LOG("Mobile hotspot is off\n");
 	}
 
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, &usbSelMode);
+	ret = um_vconf_get(ad, VCONF_USB_SEL_MODE, &usbSelMode);
 	if (0 != ret) {
 		USB_LOG("FAIL: vconf_get_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT)\n");
 		usbSelMode = SETTING_USB_DEFAULT_MODE;
@@ -71,45 +84,93 @@ int disconnectUsb(UmMainData *ad)
 	if(!ad) return -1;
 	int ret = -1;
 	int usbCurMode = -1;
+	int target = -1;
 
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT, &usbCurMode);
+	target = mode_transition_cancel(ad);
+	ret = um_vconf_get(ad, VCONF_USB_MODE, &usbCurMode);
 	um_retvm_if(ret <0, -1, "FAIL: vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT)\n");
 
-	action_clean(ad, usbCurMode);
+	/* A cancelled mode change can have started some services of its mode.
+	 * The clean-up runs from the main loop like any mode change */
+	if (0 != mode_transition_clean(ad, usbCurMode, target))
+		USB_LOG("FAIL: mode_transition_clean(%d, %d)\n", usbCurMode, target);
 
-	ret = vconf_set_int(VCONFKEY_SETAPPL_USB_MODE_INT, SETTING_USB_NONE_MODE);
+	/* Listeners see the disconnected state at once */
+	um_vconf_batch_begin(ad);
+	ret = um_vconf_set(ad, VCONF_USB_MODE, SETTING_USB_NONE_MODE);
 	if (ret != 0) {
 		USB_LOG("ERROR: vconf_set_int(VCONFKEY_SETAPPL_USB_MODE_INT)\n");
 	}
 
-	ret = vconf_set_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, SETTING_USB_DEFAULT_MODE);
+	ret = um_vconf_set(ad, VCONF_USB_SEL_MODE, SETTING_USB_DEFAULT_MODE);
 	if (0 != ret) {
 		USB_LOG("ERROR: vconf_set_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT)\n");
 	}
-	ret = vconf_set_int(VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE, CHANGE_COMPLETE);
+	ret = um_vconf_set(ad, VCONF_USB_IN_MODE_CHANGE, CHANGE_COMPLETE);
 	if (0 != ret) {
 		USB_LOG("FAIL: vconf_set_int(VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE)\n");
 	}
+	ret = um_vconf_batch_commit(ad);
+	if (0 != ret) {
+		USB_LOG("FAIL: um_vconf_batch_commit(ad)\n");
+	}
 	__USB_FUNC_EXIT__ ;
 	return 0;
 }
 
-int usb_mode_change_done(UmMainData *ad, int done)
+static void usb_configured_cb(UmMainData *ad, Eina_Bool configured)
+{
+	__USB_FUNC_ENTER__ ;
+	int usbCurMode = -1;
+	int ret = -1;
+
+	ret = um_vconf_get(ad, VCONF_USB_MODE, &usbCurMode);
+	if (0 == ret && EINA_TRUE == configured && SETTING_USB_MOBILE_HOTSPOT != usbCurMode) {
+		load_connection_popup(ad);
+	}
+
+	ret = um_vconf_set(ad, VCONF_USB_IN_MODE_CHANGE, CHANGE_COMPLETE);
+	if (0 != ret) {
+		USB_LOG("FAIL: vconf_set_int(VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE)\n");
+	}
+	__USB_FUNC_EXIT__ ;
+}
+
+/* The configfs gadget can wait for its FunctionFS daemons before it is bound.
+ * The host cannot configure it before that */
+static void usb_gadget_bound_cb(UmMainData *ad, Eina_Bool bound)
+{
+	__USB_FUNC_ENTER__ ;
+	if (EINA_TRUE == bound && 0 == um_udc_watch_start(ad, usb_configured_cb)) {
+		__USB_FUNC_EXIT__ ;
+		return;
+	}
+	usb_configured_cb(ad, bound);
+	__USB_FUNC_EXIT__ ;
+}
+
+static Eina_Bool usb_configured_waiting(UmMainData *ad)
+{
+	if (EINA_TRUE == um_configfs_binding()) return EINA_TRUE;
+	return um_udc_watching(ad);
+}
+
+/* usbSelMode is the mode which was set. The selected mode can be newer
+ * since mode changes run from the main loop */
+int usb_mode_change_done(UmMainData *ad, int usbSelMode, int done)
 {
 	__USB_FUNC_ENTER__ ;
 	if(!ad) return -1;
+	const UmModeDesc *desc = NULL;
 	int vconf_ret = -1;
 	int ret = -1;
-	int usbSelMode = -1;
 	int usbCurMode = -1;
 
-	if (VCONFKEY_SYSMAN_USB_AVAILABLE != check_usb_connection()) {
+	if (VCONFKEY_SYSMAN_USB_AVAILABLE != ad->usbStatusApplied) {
 		return 0;
 	}
 
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, &usbSelMode);
-	um_retvm_if(ret < 0, -1, "FAIL: vconf_get_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT)\n");
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT, &usbCurMode);
+	ret = um_vconf_get(ad, VCONF_USB_MODE, &usbCurMode);
 	um_retvm_if(ret < 0, -1, "FAIL: vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT)\n");
 
 	if(ACT_SUCCESS == done) {
@@ -128,20 +189,61 @@ int usb_mode_change_done(UmMainData *ad, int done)
 			break;
 		}
 		usbCurMode = usbSelMode;
-		vconf_ret = vconf_set_int(VCONFKEY_SETAPPL_USB_MODE_INT, usbCurMode);
+		vconf_ret = um_vconf_set(ad, VCONF_USB_MODE, usbCurMode);
 		um_retvm_if (0 != vconf_ret, -1, "FAIL: vconf_set_int(VCONFKEY_SETAPPL_USB_MODE_INT)\n");
+
+		/* The mode is only connected once the host configures the gadget */
+		desc = um_mode_desc_get(usbCurMode);
+		if (desc && SETTING_USB_NONE_MODE != desc->kernelMode
+				&& (0 == um_configfs_wait_bound(usb_gadget_bound_cb, ad)
+					|| 0 == um_udc_watch_start(ad, usb_configured_cb))) {
+			__USB_FUNC_EXIT__ ;
+			return 0;
+		}
 		if (SETTING_USB_MOBILE_HOTSPOT != usbCurMode) {
 			load_connection_popup(ad);
 		}
 
 	} else {	/* USB mode change failed */
-		action_clean(ad, usbSelMode);
+		if (0 != mode_transition_clean(ad, usbSelMode, -1))
+			USB_LOG("FAIL: mode_transition_clean(%d)\n", usbSelMode);
 		load_system_popup(ad, ERROR_POPUP);
 	}
 	__USB_FUNC_EXIT__ ;
 	return 0;
 }
 
+static void mode_request_apply(UmMainData *ad, int usbSelMode)
+{
+	__USB_FUNC_ENTER__ ;
+	int ret = -1;
+	int usbCurMode = -1;
+	int usbStatus = -1;
+
+	/* The cable state usb-server acted on. A newer one is applied once it settles */
+	usbStatus = ad->usbStatusApplied;
+	if (VCONFKEY_SYSMAN_USB_DISCONNECTED == usbStatus) {
+		stage_next_mode(ad);
+		return ;
+	}
+	if (VCONFKEY_SYSMAN_USB_AVAILABLE != usbStatus) {
+		return ;
+	}
+
+	ret = um_vconf_get(ad, VCONF_USB_MODE, &usbCurMode);
+	um_retm_if (0 != ret , "ERROR: Cannot get the vconf key\n");
+	/* A running mode change can be on the way away from the current mode */
+	um_retm_if (usbSelMode == usbCurMode && EINA_FALSE == transition.running
+					&& EINA_FALSE == transition.pending,
+					"Previous connection mode is same as the input mode\n");
+
+	ad->enumReport.start = ecore_time_get();
+	ret = set_USB_mode(ad, usbSelMode);
+	um_retm_if (0 != ret, "ERROR: Cannot set USB mode \n");
+
+	__USB_FUNC_EXIT__ ;
+}
+
 void change_mode_cb(keynode_t* in_key, void *data)
 {
 	__USB_FUNC_ENTER__ ;
@@ -149,56 +251,136 @@ void change_mode_cb(keynode_t* in_key, void *data)
 	UmMainData *ad = (UmMainData *)data;
 	int ret = -1;
 	int usbSelMode = -1;
-	int usbCurMode = -1;
 
-	if (VCONFKEY_SYSMAN_USB_AVAILABLE != check_usb_connection()) {
+	/* Requests of usb-server itself come through usb_mode_request_cb() */
+	if (EINA_TRUE == um_vconf_cache_notify(ad, VCONF_USB_SEL_MODE, in_key)) {
+		USB_LOG("Own mode request, already dispatched\n");
 		return ;
 	}
 
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, &usbSelMode);
+	ret = um_vconf_get(ad, VCONF_USB_SEL_MODE, &usbSelMode);
 	um_retm_if (0 != ret , "ERROR: Cannot get the vconf key\n");
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT, &usbCurMode);
+	mode_request_apply(ad, usbSelMode);
+
+	__USB_FUNC_EXIT__ ;
+	return ;
+}
+
+void usb_mode_request_cb(UmMainData *ad, UM_EVENT event, int value)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return ;
+	int ret = -1;
+	int usbSelMode = -1;
+
+	/* Another process can select a mode before the request is dispatched */
+	ret = um_vconf_get(ad, VCONF_USB_SEL_MODE, &usbSelMode);
 	um_retm_if (0 != ret , "ERROR: Cannot get the vconf key\n");
-	um_retm_if (usbSelMode == usbCurMode, "Previous connection mode is same as the input mode\n");
+	um_retm_if (usbSelMode != value, "Mode request %d is superseded by %d\n", value, usbSelMode);
+	mode_request_apply(ad, value);
 
-	ret = set_USB_mode(ad, usbSelMode);
-	um_retm_if (0 != ret, "ERROR: Cannot set USB mode \n");
+	__USB_FUNC_EXIT__ ;
+}
+
+static void mode_transition_skip(int mode)
+{
+	transition.skipped++;
+	USB_LOG("Mode %d is skipped, %u skipped so far\n", mode, transition.skipped);
+}
+
+/* Only the newest mode is applied. The running mode change is redirected to it
+ * at the next step boundary if it has not touched the kernel yet. Otherwise the
+ * mode is set once the running change is done */
+static void mode_transition_supersede(int mode)
+{
+	__USB_FUNC_ENTER__ ;
+	UmModePlan *plan = &(transition.plan);
+	int target = transition.redirect ? transition.redirectMode : plan->to;
+
+	if (EINA_TRUE == transition.pending) {
+		transition.pending = EINA_FALSE;
+		mode_transition_skip(transition.pendingMode);
+	}
+	if (EINA_TRUE == transition.running && EINA_FALSE == transition.cleaning
+			&& mode == target) {
+		USB_LOG("Mode %d is already being set\n", mode);
+		__USB_FUNC_EXIT__ ;
+		return;
+	}
+
+	/* A clean-up is never redirected, the mode is set after it */
+	if (EINA_TRUE == transition.running && EINA_FALSE == transition.cleaning
+			&& EINA_TRUE == um_mode_plan_redirectable(plan)) {
+		mode_transition_skip(target);
+		transition.redirect = EINA_TRUE;
+		transition.redirectMode = mode;
+		USB_LOG("Mode change %d -> %d will be redirected to %d\n", plan->from, plan->to, mode);
+		__USB_FUNC_EXIT__ ;
+		return;
+	}
 
+	transition.pending = EINA_TRUE;
+	transition.pendingMode = mode;
+	USB_LOG("Mode %d is set after the running mode change\n", mode);
 	__USB_FUNC_EXIT__ ;
-	return ;
 }
 
+/* The mode change runs from the main loop, set_USB_mode() returns once it is started.
+ * Requests which come during a mode change are coalesced, see mode_transition_supersede() */
 int set_USB_mode(UmMainData *ad, int mode)
 {
 	__USB_FUNC_ENTER__ ;
 	if(!ad) return -1;
 	int ret = -1;
-	int done = ACT_FAIL;
-	int usbCurMode = -1;
 
-	ret = vconf_set_int(VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE, IN_MODE_CHANGE);
-	if (0 != ret) {
-		USB_LOG("FAIL: vconf_set_int(VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE)");
+	if (EINA_TRUE == transition.running || EINA_TRUE == transition.pending) {
+		mode_transition_supersede(mode);
+		__USB_FUNC_EXIT__ ;
+		return 0;
 	}
 
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT, &usbCurMode);
-	if (0 == ret && SETTING_USB_NONE_MODE != usbCurMode) {
-		action_clean(ad, usbCurMode);
-	}
-	USB_LOG("Mode change : %d\n", mode);
-	done = run_core_action(ad, mode);
-	ret = usb_mode_change_done(ad, done);
-	um_retvm_if(0 != ret, -1, "usb_mode_change_done(ad, done)");
+	ret = mode_transition_start(ad, mode);
+	um_retvm_if(0 != ret, -1, "FAIL: mode_transition_start(%d)\n", mode);
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* The result of the mode change is published. done is ACT_SUCCESS or ACT_FAIL */
+static int mode_change_complete(UmMainData *ad, int mode, int done)
+{
+	__USB_FUNC_ENTER__ ;
+	int ret = -1;
+	int doneRet = -1;
 
-	ret = vconf_set_int(VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE, CHANGE_COMPLETE);
+	/* The new mode and the completion are written together */
+	um_vconf_batch_begin(ad);
+	doneRet = usb_mode_change_done(ad, mode, done);
+	/* Otherwise usb_configured_cb() completes the mode change */
+	if (0 == doneRet && EINA_FALSE == usb_configured_waiting(ad)) {
+		ret = um_vconf_set(ad, VCONF_USB_IN_MODE_CHANGE, CHANGE_COMPLETE);
+		if (0 != ret) {
+			USB_LOG("vconf_set_int(VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE)");
+		}
+	}
+	ret = um_vconf_batch_commit(ad);
 	if (0 != ret) {
-		USB_LOG("vconf_set_int(VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE)");
+		USB_LOG("FAIL: um_vconf_batch_commit(ad)\n");
 	}
+	um_retvm_if(0 != doneRet, -1, "usb_mode_change_done(ad, done)");
 
 	__USB_FUNC_EXIT__ ;
 	return 0;
 }
 
+/* Including the mode which waits for the host to configure the gadget */
+Eina_Bool usb_mode_changing(UmMainData *ad)
+{
+	if (!ad) return EINA_FALSE;
+	if (EINA_TRUE == transition.running || EINA_TRUE == transition.pending)
+		return EINA_TRUE;
+	return usb_configured_waiting(ad);
+}
+
 void change_hotspot_status_cb(keynode_t* in_key, void *data)
 {
 	__USB_FUNC_ENTER__ ;
@@ -208,32 +390,39 @@ void change_hotspot_status_cb(keynode_t* in_key, void *data)
 	int mh_status = -1;
 	int ret = -1;
 	int usbCurMode = -1;
-	if (VCONFKEY_SYSMAN_USB_AVAILABLE != check_usb_connection()) {
+	int usbStatus = -1;
+	um_vconf_cache_notify(ad, VCONF_MOBILE_HOTSPOT, in_key);
+	usbStatus = ad->usbStatusApplied;
+	if (VCONFKEY_SYSMAN_USB_DISCONNECTED == usbStatus) {
+		stage_next_mode(ad);
+		return;
+	}
+	if (VCONFKEY_SYSMAN_USB_AVAILABLE != usbStatus) {
 		return;
 	}
 
-	mh_status = check_mobile_hotspot_status();
+	mh_status = check_mobile_hotspot_status(ad);
 	USB_LOG("mobile_hotspot_status: %d\n", mh_status);
 	um_retm_if (0 > mh_status, "FAIL: Getting mobile hotspot status\n");
 
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT, &usbCurMode);
+	ret = um_vconf_get(ad, VCONF_USB_MODE, &usbCurMode);
 	um_retm_if (0 != ret, "FAIL: vconf_get_int(VCONF_SETAPPL_USB_MODE_INT)\n");
 
 	if (mh_status & VCONFKEY_MOBILE_HOTSPOT_MODE_USB) {
 		USB_LOG("USB Mobile hotspot is on\n");
 
 		if (usbCurMode != SETTING_USB_MOBILE_HOTSPOT) {
-			/* When mobile hotspot is on, this callabck only sets vconf key value of USB mode.
-			 * And then, the callback function for vconf change will be called */
-			ret = vconf_set_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, SETTING_USB_MOBILE_HOTSPOT);
-			um_retm_if (0 != ret, "FAIL: vconf_set_int(VCONF_SETAPPL_USB_MODE_INT)\n");
+			/* When mobile hotspot is on, this callabck only requests the USB mode.
+			 * And then, usb_mode_request_cb() will be called */
+			ret = um_event_mode_request(ad, SETTING_USB_MOBILE_HOTSPOT);
+			um_retm_if (0 != ret, "FAIL: um_event_mode_request(SETTING_USB_MOBILE_HOTSPOT)\n");
 		}
 	} else {
 		USB_LOG("USB Mobile hotspot is off\n");
 		if (usbCurMode == SETTING_USB_MOBILE_HOTSPOT) {
-			ret = vconf_set_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, ad->usbSelMode);
+			ret = um_event_mode_request(ad, ad->usbSelMode);
 			if (0 != ret) {
-				USB_LOG("FAIL: vconf_set_int(VCONF_SETAPPL_USB_SEL_MODE_INT)\n");
+				USB_LOG("FAIL: um_event_mode_request(%d)\n", ad->usbSelMode);
 				return;
 			}
 		}
@@ -241,105 +430,634 @@ void change_hotspot_status_cb(keynode_t* in_key, void *data)
 	__USB_FUNC_EXIT__ ;
 }
 
-static int check_mobile_hotspot_status()
+static int check_mobile_hotspot_status(UmMainData *ad)
 {
 	__USB_FUNC_ENTER__ ;
 
 	int mh_status = -1;
 	int ret = -1;
-	ret = vconf_get_int(VCONFKEY_MOBILE_HOTSPOT_MODE, &mh_status);
+	ret = um_vconf_get(ad, VCONF_MOBILE_HOTSPOT, &mh_status);
 	um_retvm_if (0 != ret, -1, "FAIL: vconf_get_int(VCONFKEY_MOBILE_HOTSPOT_MODE)\n");
 	__USB_FUNC_EXIT__ ;
 	return mh_status;
 }
 
+/* While the cable is unplugged, the descriptors of the mode connectUsb() will set
+ * are written ahead, so that plugging in only has to enable the gadget */
+void stage_next_mode(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return;
+	const UmModeDesc *desc = NULL;
+	int mh_status = -1;
+	int mode = -1;
+	int ret = -1;
+
+	mh_status = check_mobile_hotspot_status(ad);
+	if ((mh_status >= 0) && (mh_status & VCONFKEY_MOBILE_HOTSPOT_MODE_USB)) {
+		mode = SETTING_USB_MOBILE_HOTSPOT;
+	} else {
+		ret = um_vconf_get(ad, VCONF_USB_SEL_MODE, &mode);
+		if (0 != ret) mode = SETTING_USB_DEFAULT_MODE;
+	}
+
+	desc = um_mode_desc_get(mode);
+	if (!desc || SETTING_USB_NONE_MODE == desc->kernelMode) {
+		__USB_FUNC_EXIT__ ;
+		return;
+	}
+	if (ad->stagedMode == desc->kernelMode) {
+		USB_LOG("Kernel mode %d is already staged\n", desc->kernelMode);
+		__USB_FUNC_EXIT__ ;
+		return;
+	}
+
+	/* A failed stage leaves the nodes in an unknown state, connectUsb() rewrites them */
+	ad->stagedMode = -1;
+	ret = mode_stage_kernel(ad->driverVersion, desc->kernelMode);
+	um_retm_if(0 != ret, "FAIL: mode_stage_kernel(%d)\n", desc->kernelMode);
+	ad->stagedMode = desc->kernelMode;
+	USB_LOG("Kernel mode %d is staged for mode %d\n", desc->kernelMode, mode);
+	__USB_FUNC_EXIT__ ;
+}
+
 /****************************************************/
 /* Functions related to mode change                 */
 /****************************************************/
 
-static int run_core_action(UmMainData *ad, int mode)
+/* Commands of a step, which are run one after another.
+ * usb0 is set by rtnetlink, its commands are only used if that fails */
+static int mode_step_cmds(UmModeStep *step, char *cmds[])
+{
+	Eina_Bool start = (MODE_STEP_SERVICE_START == step->type) ? EINA_TRUE : EINA_FALSE;
+
+	switch (step->type) {
+	case MODE_STEP_SERVICE_STOP:
+	case MODE_STEP_SERVICE_START:
+		switch (step->arg) {
+		case MODE_SERVICE_SDBD:
+			cmds[0] = start ? SDBD_START : SDBD_STOP;
+			return 1;
+		case MODE_SERVICE_SSHD:
+			cmds[0] = start ? OPENSSHD_START : OPENSSHD_STOP;
+			return 1;
+		default:
+			return 0;
+		}
+	case MODE_STEP_NET_DOWN:
+		cmds[0] = UNSET_USB0_IP;
+		return 1;
+	case MODE_STEP_NET_UP:
+		cmds[0] = SET_USB0_IP;
+		cmds[1] = ADD_DEFAULT_GW;
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+static void mode_step_done(UmModePlan *plan, UmModeStep *step)
+{
+	step->state = MODE_STEP_DONE;
+	step->end = ecore_time_get();
+	plan->numDone++;
+}
+
+static void mode_step_next_cmd(UmModePlan *plan, UmModeStep *step);
+static void mode_transition_advance(UmMainData *ad);
+
+/* After a step waited for, mode_transition_advance() goes on by itself */
+static void mode_plan_resume(UmModePlan *plan)
+{
+	if (plan == &(transition.plan) && EINA_TRUE == transition.running
+			&& EINA_FALSE == transition.advancing)
+		mode_transition_advance(transition.ad);
+}
+
+/* The usb0 step falls back to the commands if rtnetlink fails */
+static void mode_step_rtnl_done(int ret, void *data)
 {
 	__USB_FUNC_ENTER__ ;
-	if(!ad) return ACT_FAIL;
-	int ret = -1;
-	int usbCurMode = -1;
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT, &usbCurMode);
-	um_retvm_if(0 != ret, ACT_FAIL, "FAIL: vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT)\n");
+	UmModeStep *step = (UmModeStep *)data;
+	if (!step || !step->plan) return;
+	UmModePlan *plan = step->plan;
 
-	switch(mode)
-	{
-	case SETTING_USB_DEFAULT_MODE:
-		USB_LOG("Mode : SETTING_USB_DFAULT_MODE\n");
-		ret = mode_set_kernel(ad->driverVersion, SETTING_USB_DEFAULT_MODE);
-		um_retvm_if(0 != ret, ACT_FAIL, "FAIL : mode_set_kernel()\n");
-		start_dr(ad);
-		call_cmd(SDBD_START);
-		break;
+	step->rtnl = EINA_FALSE;
+	plan->numRunning--;
+	if (0 == ret) {
+		mode_step_done(plan, step);
+	} else {
+		USB_LOG("FAIL: rtnetlink step %d. Use the commands\n", (int)(step - plan->steps));
+		mode_step_next_cmd(plan, step);
+	}
+	mode_plan_resume(plan);
+	__USB_FUNC_EXIT__ ;
+}
 
-	case SETTING_USB_DEBUG_MODE:
-		USB_LOG("Mode: SETTING_USB_DEBUG_MODE\n");
-		if (SETTING_USB_MOBILE_HOTSPOT != usbCurMode) {
-			ret = mode_set_kernel(ad->driverVersion, SETTING_USB_DEBUG_MODE);
-			um_retvm_if(0 != ret, ACT_FAIL, "FAIL : mode_set_kernel()\n");
-			call_cmd(SET_USB0_IP);
-			call_cmd(ADD_DEFAULT_GW);
-		}
-		call_cmd(OPENSSHD_START);
-
-	case SETTING_USB_MOBILE_HOTSPOT:
-		USB_LOG("Mode : SETTING_USB_MOBILE_HOTSPOT\n");
-		if (SETTING_USB_DEBUG_MODE != usbCurMode) {
-			ret = mode_set_kernel(ad->driverVersion, SETTING_USB_DEBUG_MODE);
-			um_retvm_if(0 != ret, ACT_FAIL, "FAIL : mode_set_kernel()\n");
-			call_cmd(SET_USB0_IP);
-			call_cmd(ADD_DEFAULT_GW);
-		}
-		break;
+static void mode_step_cmd_done(pid_t pid, int status, void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	UmModeStep *step = (UmModeStep *)data;
+	if (!step || !step->plan) return;
+	UmModePlan *plan = step->plan;
 
-	case SETTING_USB_ACCESSORY_MODE:
-		USB_LOG("Mode : SETTING_USB_ACCESSORY_MODE\n");
-		ret = mode_set_kernel(ad->driverVersion, SETTING_USB_ACCESSORY_MODE);
-		um_retvm_if(0 != ret, ACT_FAIL, "FAIL : mode_set_kernel()\n");
-		break;
+	USB_LOG("Step %d command %d(%d) returns %d\n", (int)(step - plan->steps),
+					step->numCmds - 1, pid, status);
+	step->pid = -1;
+	plan->numRunning--;
+	mode_step_next_cmd(plan, step);
+	mode_plan_resume(plan);
+	__USB_FUNC_EXIT__ ;
+}
 
-	default:
-		break;
+static void mode_step_next_cmd(UmModePlan *plan, UmModeStep *step)
+{
+	__USB_FUNC_ENTER__ ;
+	char *cmds[MODE_STEP_MAX_CMDS];
+	int numCmds = mode_step_cmds(step, cmds);
+	UmProcPriority prio = { um_proc_base_nice(), SCHED_OTHER };
+	pid_t pid;
+
+	/* Daemons keep the priority they are started with for their whole life,
+	 * so services start at the normal one. Only the short commands of critical
+	 * steps run at criticalNice, the other ones in the background */
+	if (MODE_STEP_SERVICE_START != step->type && step->critical)
+		prio.nice = plan->prio->criticalNice;
+	else if (MODE_STEP_SERVICE_START != step->type)
+		prio = plan->prio->helper;
+	step->nice = prio.nice;
+	step->policy = prio.policy;
+
+	/* A failed command does not stop the mode change, as with system() before */
+	while (step->numCmds < numCmds) {
+		plan->numRunning++;
+		pid = um_proc_spawn_cmd(cmds[step->numCmds++], &prio, mode_step_cmd_done, step);
+		if (pid >= 0) {
+			/* Otherwise the command is already done */
+			if (um_proc_watching()) step->pid = pid;
+			__USB_FUNC_EXIT__ ;
+			return;
+		}
+		plan->numRunning--;
+		USB_LOG("FAIL: um_proc_spawn_cmd(%s)\n", cmds[step->numCmds - 1]);
 	}
+	mode_step_done(plan, step);
 	__USB_FUNC_EXIT__ ;
-	return ACT_SUCCESS;
 }
 
-int action_clean(UmMainData *ad, int mode)
+static void mode_step_start(UmMainData *ad, UmModePlan *plan, UmModeStep *step)
 {
 	__USB_FUNC_ENTER__ ;
-	if(!ad) return -1;
 	int ret = -1;
-	int usbSelMode = -1;
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, &usbSelMode);
 
-	switch(mode) {
-	case SETTING_USB_DEFAULT_MODE:
-		USB_LOG("Mode : SETTING_USB_DEFAULT_MODE action_clean\n");
-		call_cmd(SDBD_STOP);
+	step->plan = plan;
+	step->state = MODE_STEP_RUNNING;
+	step->pid = -1;
+	step->rtnl = EINA_FALSE;
+	step->begin = ecore_time_get();
+	step->nice = plan->nice;	/* Until it spawns commands */
+	step->policy = SCHED_OTHER;
+	if (MODE_STEP_NET_UP == step->type || MODE_STEP_NET_DOWN == step->type)
+		step->deadline = step->begin + MODE_STEP_DEADLINE_NET;
+	else
+		step->deadline = step->begin + MODE_STEP_DEADLINE_SERVICE;
+
+	switch (step->type) {
+	case MODE_STEP_KERNEL_DISABLE:
+	case MODE_STEP_KERNEL_SET:
+		ret = mode_set_kernel(ad->driverVersion, step->arg);
+		if (0 != ret) {
+			USB_LOG("FAIL : mode_set_kernel(%d)\n", step->arg);
+			plan->failed = EINA_TRUE;
+		}
+		mode_step_done(plan, step);
 		break;
-	case SETTING_USB_DEBUG_MODE:
-		call_cmd(OPENSSHD_STOP);
-		if (SETTING_USB_MOBILE_HOTSPOT == usbSelMode) {
-			call_cmd(OPENSSHD_STOP);
+	/* The acks are waited for from the main loop, within the deadline of the step */
+	case MODE_STEP_NET_DOWN:
+		if (0 == um_rtnl_net_down(USB0_IFNAME, USB0_ADDR, USB0_PREFIX_LEN,
+						mode_step_rtnl_done, step)) {
+			step->rtnl = EINA_TRUE;
+			plan->numRunning++;
+			break;
 		}
+		USB_LOG("FAIL: um_rtnl_net_down(). Use ifconfig\n");
+		mode_step_next_cmd(plan, step);
 		break;
-	case SETTING_USB_MOBILE_HOTSPOT:
-		USB_LOG("Mode : SETTING_USB_MOBILE_HOTSPOT action_clean\n");
-		if (SETTING_USB_DEBUG_MODE == usbSelMode) {
-			call_cmd(UNSET_USB0_IP);
+	case MODE_STEP_NET_UP:
+		if (0 == um_rtnl_net_up(USB0_IFNAME, USB0_ADDR, USB0_NET, USB0_PREFIX_LEN,
+						mode_step_rtnl_done, step)) {
+			step->rtnl = EINA_TRUE;
+			plan->numRunning++;
+			break;
 		}
+		USB_LOG("FAIL: um_rtnl_net_up(). Use ifconfig and route\n");
+		mode_step_next_cmd(plan, step);
 		break;
-	case SETTING_USB_ACCESSORY_MODE:
+	case MODE_STEP_SERVICE_START:
+	case MODE_STEP_SERVICE_STOP:
+		if (MODE_SERVICE_DATA_ROUTER == step->arg) {
+			if (MODE_STEP_SERVICE_START == step->type)
+				start_dr(ad);
+			else
+				stop_dr(ad);
+			mode_step_done(plan, step);
+			break;
+		}
+		/* fall through */
 	default:
+		mode_step_next_cmd(plan, step);
 		break;
 	}
-	ret = mode_set_kernel(ad->driverVersion, SETTING_USB_NONE_MODE);
-	um_retvm_if(0 != ret, -1, "FAIL: mode_set_kernel(SETTING_USB_SAMSUNG_KIES)");
+	__USB_FUNC_EXIT__ ;
+}
+
+/* Starts every step whose dependencies are done.
+ * Returns the number of started steps */
+static int mode_plan_start_ready(UmMainData *ad, UmModePlan *plan)
+{
+	unsigned int done = 0;
+	int started = 0;
+	int i;
+
+	if (plan->failed) return 0;
+
+	for (i = 0 ; i < plan->numSteps ; i++) {
+		if (MODE_STEP_DONE == plan->steps[i].state)
+			done |= 1 << i;
+	}
+	for (i = 0 ; i < plan->numSteps && !plan->failed ; i++) {
+		if (MODE_STEP_PENDING != plan->steps[i].state) continue;
+		if ((plan->steps[i].deps & done) != plan->steps[i].deps) continue;
+		mode_step_start(ad, plan, &(plan->steps[i]));
+		started++;
+	}
+	return started;
+}
+
+/* The command of the step is killed and not waited for any more */
+static void mode_step_kill(UmModePlan *plan, UmModeStep *step)
+{
+	if (EINA_TRUE == step->rtnl) {
+		um_rtnl_cancel();
+		step->rtnl = EINA_FALSE;
+		plan->numRunning--;
+		return;
+	}
+	if (step->pid <= 0) return;
+	um_proc_detach(step->pid);
+	/* The commands are scripts, so their children are killed as well */
+	if (kill(-(step->pid), SIGKILL) < 0) USB_LOG("FAIL: kill(%d)\n", -(step->pid));
+	step->pid = -1;
+	plan->numRunning--;
+}
+
+static void mode_step_expire(UmModePlan *plan, UmModeStep *step, double now)
+{
+	__USB_FUNC_ENTER__ ;
+	if (now >= step->deadline)
+		USB_LOG("ERROR: Step %d misses its deadline by %.3f ms (command %d, pid %d)\n",
+					(int)(step - plan->steps), (now - step->deadline) * 1000,
+					step->numCmds - 1, step->pid);
+	else
+		USB_LOG("ERROR: Step %d is stopped at the end of the budget (command %d, pid %d)\n",
+					(int)(step - plan->steps), step->numCmds - 1, step->pid);
+	mode_step_kill(plan, step);
+	step->timedOut = EINA_TRUE;
+	plan->numTimedOut++;
+	plan->failed = EINA_TRUE;
+	mode_step_done(plan, step);
+	__USB_FUNC_EXIT__ ;
+}
+
+/* Expires the running steps which are past their deadline.
+ * Returns the nearest deadline of the other steps */
+static double mode_plan_expire(UmModePlan *plan, double now, double budgetEnd)
+{
+	UmModeStep *step;
+	double next = budgetEnd;
+	int i;
+
+	for (i = 0 ; i < plan->numSteps ; i++) {
+		step = &(plan->steps[i]);
+		if (MODE_STEP_RUNNING != step->state) continue;
+		if (now >= step->deadline || now >= budgetEnd)
+			mode_step_expire(plan, step, now);
+		else if (step->deadline < next)
+			next = step->deadline;
+	}
+	return next;
+}
+
+static void mode_plan_begin(UmModePlan *plan)
+{
+	um_mode_plan_log(plan);
+	plan->maxSlice = 0;
+
+	/* Kernel and usb0 steps run in usb-server itself */
+	plan->nice = um_proc_base_nice();
+	if (0 == setpriority(PRIO_PROCESS, 0, plan->prio->transitionNice))
+		plan->nice = plan->prio->transitionNice;
+	else
+		USB_LOG("FAIL: setpriority(%d): %s\n", plan->prio->transitionNice, strerror(errno));
+
+	plan->begin = ecore_time_get();
+}
+
+static void mode_plan_end(UmModePlan *plan)
+{
+	plan->end = ecore_time_get();
+	if (plan->nice != um_proc_base_nice()
+			&& 0 != setpriority(PRIO_PROCESS, 0, um_proc_base_nice()))
+		USB_LOG("FAIL: setpriority(%d): %s\n", um_proc_base_nice(), strerror(errno));
+	um_mode_plan_log_timing(plan);
+}
+
+static void mode_transition_next(UmMainData *ad);
+
+/* Runs the callback of mode_transition_wait() once nothing is left to do */
+static void mode_transition_idle(void)
+{
+	Ecore_Cb cb = transition.idleCb;
+	void *data = transition.idleData;
+
+	if (!cb || EINA_TRUE == transition.running || EINA_TRUE == transition.pending) return;
+	transition.idleCb = NULL;
+	transition.idleData = NULL;
+	cb(data);
+}
+
+static void mode_transition_finish(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	UmModePlan *plan = &(transition.plan);
+	int mode = plan->to;
+	int done = ACT_SUCCESS;
+
+	mode_plan_end(plan);
+	if (plan->failed || plan->numDone < plan->numSteps) {
+		USB_LOG("FAIL: %d of %d steps are done, %d missed the deadline\n",
+					plan->numDone, plan->numSteps, plan->numTimedOut);
+		done = ACT_FAIL;
+	}
+	/* A failed mode change reuses the plan for its clean-up */
+	transition.running = EINA_FALSE;
+	if (EINA_TRUE == transition.cleaning) {
+		transition.cleaning = EINA_FALSE;
+		USB_LOG("Clean-up of mode %d is done\n", plan->from);
+	} else if (0 != mode_change_complete(ad, mode, done)) {
+		USB_LOG("FAIL: mode_change_complete(%d)\n", mode);
+	}
+	mode_transition_next(ad);
+	mode_transition_idle();
+	__USB_FUNC_EXIT__ ;
+}
+
+/* Called at a step boundary, when no step of the plan runs */
+static void mode_transition_redirect(void)
+{
+	__USB_FUNC_ENTER__ ;
+	UmModePlan *plan = &(transition.plan);
+	int mode = transition.redirectMode;
+
+	transition.redirect = EINA_FALSE;
+	/* A step failed meanwhile, the mode is set after the failure is handled */
+	if (EINA_FALSE == um_mode_plan_redirectable(plan)) {
+		transition.pending = EINA_TRUE;
+		transition.pendingMode = mode;
+		__USB_FUNC_EXIT__ ;
+		return;
+	}
+
+	USB_LOG("Mode change %d -> %d is redirected to %d after %d of %d steps\n",
+					plan->from, plan->to, mode, plan->numDone, plan->numSteps);
+	mode_plan_end(plan);
+	if (0 != um_mode_plan_redirect(plan, mode)) {
+		/* Not reached, the plan is redirectable */
+		plan->failed = EINA_TRUE;
+		__USB_FUNC_EXIT__ ;
+		return;
+	}
+	mode_plan_begin(plan);
+	transition.budgetEnd = plan->begin + MODE_PLAN_BUDGET;
+	__USB_FUNC_EXIT__ ;
+}
+
+static Eina_Bool mode_transition_timer_cb(void *data)
+{
+	transition.timer = NULL;
+	mode_transition_advance((UmMainData *)data);
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/* Does what can be done without waiting for commands, then returns to the
+ * main loop. It is called again when a command exits or at the nearest deadline */
+static void mode_transition_advance(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	UmModePlan *plan = &(transition.plan);
+	double sliceBegin = ecore_time_get();
+	double next;
+	double now;
+
+	if (EINA_FALSE == transition.running) return;
+	transition.advancing = EINA_TRUE;
+	if (transition.timer) {
+		ecore_timer_del(transition.timer);
+		transition.timer = NULL;
+	}
+
+	while (plan->numDone < plan->numSteps || EINA_TRUE == transition.redirect) {
+		/* No step is started for a superseded plan, the running ones are waited for */
+		if (EINA_TRUE == transition.redirect) {
+			if (plan->numRunning <= 0) {
+				mode_transition_redirect();
+				continue;
+			}
+		} else if (mode_plan_start_ready(ad, plan) > 0) {
+			continue;
+		}
+		if (plan->numRunning <= 0) break;
+
+		now = ecore_time_get();
+		next = mode_plan_expire(plan, now, transition.budgetEnd);
+		if (now >= transition.budgetEnd) {
+			USB_LOG("ERROR: Mode plan %d -> %d misses its budget of %.1f s\n",
+							plan->from, plan->to, MODE_PLAN_BUDGET);
+			break;
+		}
+		if (plan->numRunning <= 0) continue;
+
+		/* Without the timer, the deadlines are checked when a command exits */
+		transition.timer = ecore_timer_add(next - now, mode_transition_timer_cb, ad);
+		if (!transition.timer) USB_LOG("FAIL: ecore_timer_add(). Wait for the commands\n");
+		transition.advancing = EINA_FALSE;
+		now = ecore_time_get();
+		if (now - sliceBegin > plan->maxSlice) plan->maxSlice = now - sliceBegin;
+		__USB_FUNC_EXIT__ ;
+		return;
+	}
+
+	transition.advancing = EINA_FALSE;
+	now = ecore_time_get();
+	if (now - sliceBegin > plan->maxSlice) plan->maxSlice = now - sliceBegin;
+	mode_transition_finish(ad);
+	__USB_FUNC_EXIT__ ;
+}
+
+static void mode_transition_run(UmMainData *ad, Eina_Bool cleaning)
+{
+	transition.ad = ad;
+	transition.running = EINA_TRUE;
+	transition.cleaning = cleaning;
+	mode_plan_begin(&(transition.plan));
+	transition.budgetEnd = transition.plan.begin + MODE_PLAN_BUDGET;
+	mode_transition_advance(ad);
+}
+
+/* Only the differences between the current mode and the new mode are applied.
+ * The gadget is not re-enumerated if both modes use the same configuration */
+static int mode_transition_start(UmMainData *ad, int mode)
+{
+	__USB_FUNC_ENTER__ ;
+	if(!ad) return -1;
+	int ret = -1;
+	int usbCurMode = -1;
+
+	um_udc_watch_stop(ad);
+	ret = um_vconf_set(ad, VCONF_USB_IN_MODE_CHANGE, IN_MODE_CHANGE);
+	if (0 != ret) {
+		USB_LOG("FAIL: vconf_set_int(VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE)");
+	}
+
+	ret = um_vconf_get(ad, VCONF_USB_MODE, &usbCurMode);
+	if (0 != ret) {
+		USB_LOG("FAIL: vconf_get_int(VCONFKEY_SETAPPL_USB_MODE_INT)\n");
+		usbCurMode = MODE_PLAN_UNKNOWN_MODE;
+	}
+	USB_LOG("Mode change : %d -> %d\n", usbCurMode, mode);
+
+	ret = um_mode_plan_build(&(transition.plan), usbCurMode, mode, EINA_FALSE);
+	if (0 != ret) {
+		USB_LOG("FAIL: um_mode_plan_build(%d, %d)\n", usbCurMode, mode);
+		ret = mode_change_complete(ad, mode, ACT_FAIL);
+		__USB_FUNC_EXIT__ ;
+		return ret;
+	}
+
+	mode_transition_run(ad, EINA_FALSE);
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+/* Stops from the main loop what modes 'mode' and 'other' started, after a failed
+ * mode change or a disconnection. 'other' is -1 if there is only one.
+ * A mode set meanwhile is applied after it */
+static int mode_transition_clean(UmMainData *ad, int mode, int other)
+{
+	__USB_FUNC_ENTER__ ;
+	if(!ad) return -1;
+	int ret = -1;
+
+	um_retvm_if(EINA_TRUE == transition.running, -1, "Mode change %d -> %d is running\n",
+					transition.plan.from, transition.plan.to);
+	ret = um_mode_plan_build_clean(&(transition.plan), mode, other);
+	um_retvm_if(0 != ret, -1, "FAIL: um_mode_plan_build_clean(%d, %d)\n", mode, other);
+
+	mode_transition_run(ad, EINA_TRUE);
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+static void mode_transition_next_cb(void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	UmMainData *ad = (UmMainData *)data;
+	int usbCurMode = -1;
+	int mode;
+
+	transition.nextJob = NULL;
+	if (EINA_FALSE == transition.pending || EINA_TRUE == transition.running) return;
+	mode = transition.pendingMode;
+	transition.pending = EINA_FALSE;
+
+	if (0 == um_vconf_get(ad, VCONF_USB_MODE, &usbCurMode) && mode == usbCurMode) {
+		USB_LOG("Mode %d is already set\n", mode);
+		mode_transition_idle();
+		__USB_FUNC_EXIT__ ;
+		return;
+	}
+	if (0 != mode_transition_start(ad, mode))
+		USB_LOG("FAIL: mode_transition_start(%d)\n", mode);
+	mode_transition_idle();
+	__USB_FUNC_EXIT__ ;
+}
+
+/* From a job, so that the finished mode change is published first */
+static void mode_transition_next(UmMainData *ad)
+{
+	if (EINA_FALSE == transition.pending || transition.nextJob) return;
+	transition.nextJob = ecore_job_add(mode_transition_next_cb, ad);
+	if (!transition.nextJob) {
+		USB_LOG("FAIL: ecore_job_add(). Start the next mode now\n");
+		mode_transition_next_cb(ad);
+	}
+}
+
+/* The running mode change is stopped where it is and the requested modes are dropped.
+ * Returns the mode it was changing to, or the one it was cleaning up.
+ * -1 if none was running */
+int mode_transition_cancel(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	UmModePlan *plan = &(transition.plan);
+	int i;
+
+	transition.pending = EINA_FALSE;
+	transition.redirect = EINA_FALSE;
+	if (transition.nextJob) {
+		ecore_job_del(transition.nextJob);
+		transition.nextJob = NULL;
+	}
+	if (EINA_FALSE == transition.running) {
+		__USB_FUNC_EXIT__ ;
+		return -1;
+	}
+
+	if (transition.timer) {
+		ecore_timer_del(transition.timer);
+		transition.timer = NULL;
+	}
+	USB_LOG("Mode change %d -> %d is cancelled after %d of %d steps\n",
+					plan->from, plan->to, plan->numDone, plan->numSteps);
+	for (i = 0 ; i < plan->numSteps ; i++) {
+		if (MODE_STEP_RUNNING != plan->steps[i].state) continue;
+		mode_step_kill(plan, &(plan->steps[i]));
+		mode_step_done(plan, &(plan->steps[i]));
+	}
+	plan->failed = EINA_TRUE;
+	mode_plan_end(plan);
+	transition.running = EINA_FALSE;
+	if (EINA_TRUE == transition.cleaning) {
+		transition.cleaning = EINA_FALSE;
+		__USB_FUNC_EXIT__ ;
+		return plan->from;
+	}
+	__USB_FUNC_EXIT__ ;
+	return plan->to;
+}
+
+/* cb is called once the running mode change or clean-up and the requested modes are done.
+ * Returns -1 if nothing runs, then cb is not called */
+int mode_transition_wait(Ecore_Cb cb, void *data)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!cb) return -1;
+	if (EINA_FALSE == transition.running && EINA_FALSE == transition.pending) {
+		__USB_FUNC_EXIT__ ;
+		return -1;
+	}
+	transition.idleCb = cb;
+	transition.idleData = data;
 	__USB_FUNC_EXIT__ ;
 	return 0;
 }
@@ -352,7 +1070,7 @@ void usb_connection_selected_btn(UmMainData *ad, int input)
 {
 	__USB_FUNC_ENTER__ ;
 	if(!ad) return ;
-	if (VCONFKEY_SYSMAN_USB_AVAILABLE != check_usb_connection()) {
+	if (VCONFKEY_SYSMAN_USB_AVAILABLE != ad->usbStatusApplied) {
 		return;
 	}
 
@@ -372,8 +1090,8 @@ int response_error_popup(UmMainData *ad)
 	__USB_FUNC_ENTER__ ;
 	if(!ad) return -1;
 	int ret = -1;
-	ret = vconf_set_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, SETTING_USB_SAMSUNG_KIES);
-	um_retvm_if(0 != ret, -1, "ERROR: Cannot set the vconf key\n");
+	ret = um_event_mode_request(ad, SETTING_USB_SAMSUNG_KIES);
+	um_retvm_if(0 != ret, -1, "ERROR: Cannot request the USB mode\n");
 
 	__USB_FUNC_EXIT__ ;
 	return 0;
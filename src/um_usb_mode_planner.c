@@ -0,0 +1,285 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_usb_mode_planner.h"
+
+/* The user waits for the host to see the gadget and its sdbd or accessory */
+#define MODE_PRIO_CONNECT		{ -10, -5, { 5, SCHED_BATCH } }
+/* The host retries on usb0 for a while, so these preempt less */
+#define MODE_PRIO_NETWORK		{ -5, -5, { 10, SCHED_BATCH } }
+/* Nobody waits for a disconnection, its helpers only run on an idle CPU */
+#define MODE_PRIO_DISCONNECT	{ 0, 0, { 10, SCHED_IDLE } }
+
+/* Debug mode and mobile hotspot use the same rndis configuration and usb0 address,
+ * so switching between them only starts or stops sshd */
+static const UmModeDesc modeDescs[] = {
+	{ SETTING_USB_NONE_MODE,		SETTING_USB_NONE_MODE,		0,
+				EINA_FALSE,	0,					MODE_PRIO_DISCONNECT },
+	{ SETTING_USB_DEFAULT_MODE,		SETTING_USB_DEFAULT_MODE,	MODE_SERVICE_DATA_ROUTER | MODE_SERVICE_SDBD,
+				EINA_FALSE,	MODE_SERVICE_SDBD,	MODE_PRIO_CONNECT },
+	{ SETTING_USB_DEBUG_MODE,		SETTING_USB_DEBUG_MODE,		MODE_SERVICE_SSHD,
+				EINA_TRUE,	MODE_SERVICE_SSHD,	MODE_PRIO_NETWORK },
+	{ SETTING_USB_MOBILE_HOTSPOT,	SETTING_USB_DEBUG_MODE,		0,
+				EINA_TRUE,	0,					MODE_PRIO_NETWORK },
+	{ SETTING_USB_ACCESSORY_MODE,	SETTING_USB_ACCESSORY_MODE,	0,
+				EINA_FALSE,	0,					MODE_PRIO_CONNECT }
+};
+
+static const char *stepNames[MAX_NUM_MODE_STEP_TYPE] = {
+	"SERVICE_STOP",
+	"NET_DOWN",
+	"KERNEL_DISABLE",
+	"KERNEL_SET",
+	"NET_UP",
+	"SERVICE_START"
+};
+
+const UmModeDesc *um_mode_desc_get(int mode)
+{
+	int i;
+	for (i = 0 ; i < sizeof(modeDescs) / sizeof(modeDescs[0]) ; i++) {
+		if (modeDescs[i].mode == mode)
+			return &(modeDescs[i]);
+	}
+	return NULL;
+}
+
+/* Returns the bit of the new step to be used in deps, or 0 on failure */
+static unsigned int mode_plan_add(UmModePlan *plan, MODE_STEP_TYPE type, int arg, unsigned int deps)
+{
+	um_retvm_if(plan->numSteps >= MAX_MODE_STEPS, 0, "FAIL: too many steps in the plan\n");
+	plan->steps[plan->numSteps].type = type;
+	plan->steps[plan->numSteps].arg = arg;
+	plan->steps[plan->numSteps].deps = deps;
+	plan->steps[plan->numSteps].critical = EINA_TRUE;
+	plan->numSteps++;
+	return 1 << (plan->numSteps - 1);
+}
+
+/* Fills the plan to go from the services and usb0 state of 'cur' to mode 'to' */
+static int mode_plan_fill(UmModePlan *plan, int from, const UmModeDesc *cur, int services,
+						Eina_Bool usb0Ip, int to, Eina_Bool forceKernel)
+{
+	const UmModeDesc *next = NULL;
+	int stop;
+	int start;
+	int bit;
+	unsigned int gadgetDown = 0;
+	unsigned int netDown = 0;
+	unsigned int kernel = 0;
+	Eina_Bool kernelChange;
+
+	memset(plan, 0x0, sizeof(UmModePlan));
+	plan->from = from;
+	plan->to = to;
+	plan->services = services;
+	plan->usb0Ip = usb0Ip;
+
+	next = um_mode_desc_get(to);
+	if (!next) {
+		USB_LOG("Mode %d does not need any action\n", to);
+		next = um_mode_desc_get(SETTING_USB_NONE_MODE);
+	}
+
+	kernelChange = (forceKernel || cur->kernelMode != next->kernelMode) ? EINA_TRUE : EINA_FALSE;
+	stop = services & ~(next->services);
+	start = next->services & ~services;
+
+	plan->prio = &(next->prio);
+
+	for (bit = 0 ; bit < MAX_NUM_MODE_SERVICE ; bit++) {
+		if (!(stop & (1 << bit))) continue;
+		if ((1 << bit) & MODE_SERVICE_PERSISTENT) {
+			if (mode_plan_add(plan, MODE_STEP_SERVICE_STOP, 1 << bit, 0))
+				plan->steps[plan->numSteps - 1].critical = EINA_FALSE;
+		} else if ((1 << bit) & MODE_SERVICE_GADGET)
+			gadgetDown |= mode_plan_add(plan, MODE_STEP_SERVICE_STOP, 1 << bit, 0);
+		else if (mode_plan_add(plan, MODE_STEP_SERVICE_STOP, 1 << bit, 0))
+			plan->steps[plan->numSteps - 1].critical = EINA_FALSE;	/* Nothing waits for it */
+	}
+
+	if (usb0Ip && (!next->usb0Ip || kernelChange))
+		netDown = mode_plan_add(plan, MODE_STEP_NET_DOWN, 0, 0);
+
+	if (kernelChange) {
+		if (SETTING_USB_NONE_MODE == next->kernelMode)
+			kernel = mode_plan_add(plan, MODE_STEP_KERNEL_DISABLE, SETTING_USB_NONE_MODE,
+								gadgetDown | netDown);
+		else
+			kernel = mode_plan_add(plan, MODE_STEP_KERNEL_SET, next->kernelMode,
+								gadgetDown | netDown);
+	}
+
+	if (next->usb0Ip && (!usb0Ip || kernelChange))
+		mode_plan_add(plan, MODE_STEP_NET_UP, 0, kernel | netDown);
+
+	for (bit = 0 ; bit < MAX_NUM_MODE_SERVICE ; bit++) {
+		if (!(start & (1 << bit))) continue;
+		if (!mode_plan_add(plan, MODE_STEP_SERVICE_START, 1 << bit,
+						((1 << bit) & MODE_SERVICE_GADGET) ? kernel : 0))
+			continue;
+		if (!((1 << bit) & next->criticalServices))
+			plan->steps[plan->numSteps - 1].critical = EINA_FALSE;
+	}
+	return 0;
+}
+
+/* Builds the minimal graph of steps to go from mode 'from' to mode 'to'.
+ * If 'from' is unknown or forceKernel is set, the kernel step is always included.
+ * Only the kernel step orders the steps: gadget services and usb0 go down before it
+ * and come up after it. Everything else can run at the same time */
+int um_mode_plan_build(UmModePlan *plan, int from, int to, Eina_Bool forceKernel)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!plan) return -1;
+	const UmModeDesc *cur = NULL;
+	int ret = -1;
+
+	cur = um_mode_desc_get(from);
+	if (!cur) {
+		USB_LOG("Current mode %d is unknown\n", from);
+		cur = um_mode_desc_get(SETTING_USB_NONE_MODE);
+		forceKernel = EINA_TRUE;
+	}
+
+	ret = mode_plan_fill(plan, from, cur, cur->services, cur->usb0Ip, to, forceKernel);
+	__USB_FUNC_EXIT__ ;
+	return ret;
+}
+
+/* Builds the plan which stops whatever modes 'mode' and 'other' can have started and
+ * disables the gadget. A cancelled mode change leaves a mix of both.
+ * 'other' is ignored if it is not a known mode */
+int um_mode_plan_build_clean(UmModePlan *plan, int mode, int other)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!plan) return -1;
+	const UmModeDesc *cur = NULL;
+	const UmModeDesc *desc = NULL;
+	int services;
+	Eina_Bool usb0Ip;
+	int ret = -1;
+
+	cur = um_mode_desc_get(mode);
+	if (!cur) cur = um_mode_desc_get(SETTING_USB_NONE_MODE);
+	services = cur->services;
+	usb0Ip = cur->usb0Ip;
+	desc = um_mode_desc_get(other);
+	if (desc) {
+		services |= desc->services;
+		usb0Ip = (usb0Ip || desc->usb0Ip) ? EINA_TRUE : EINA_FALSE;
+	}
+
+	ret = mode_plan_fill(plan, mode, cur, services, usb0Ip, SETTING_USB_NONE_MODE, EINA_TRUE);
+	__USB_FUNC_EXIT__ ;
+	return ret;
+}
+
+/* Only stopping services and usb0 can be undone without touching the kernel */
+Eina_Bool um_mode_plan_redirectable(UmModePlan *plan)
+{
+	if (!plan || plan->failed) return EINA_FALSE;
+	int i;
+
+	for (i = 0 ; i < plan->numSteps ; i++) {
+		if (MODE_STEP_PENDING == plan->steps[i].state) continue;
+		if (MODE_STEP_SERVICE_STOP != plan->steps[i].type
+				&& MODE_STEP_NET_DOWN != plan->steps[i].type)
+			return EINA_FALSE;
+	}
+	return EINA_TRUE;
+}
+
+/* Rebuilds a plan which stopped at a step boundary to go to mode 'to' instead.
+ * The new plan starts from what the done steps left: services they stopped
+ * are started again if 'to' needs them */
+int um_mode_plan_redirect(UmModePlan *plan, int to)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!plan) return -1;
+	const UmModeDesc *cur = NULL;
+	Eina_Bool forceKernel = EINA_FALSE;
+	Eina_Bool usb0Ip;
+	int services;
+	int ret = -1;
+	int i;
+
+	um_retvm_if(EINA_FALSE == um_mode_plan_redirectable(plan) || plan->numRunning > 0, -1,
+					"Mode plan %d -> %d cannot be redirected\n", plan->from, plan->to);
+
+	cur = um_mode_desc_get(plan->from);
+	if (!cur) {
+		cur = um_mode_desc_get(SETTING_USB_NONE_MODE);
+		forceKernel = EINA_TRUE;
+	}
+	services = plan->services;
+	usb0Ip = plan->usb0Ip;
+	for (i = 0 ; i < plan->numSteps ; i++) {
+		if (MODE_STEP_DONE != plan->steps[i].state) continue;
+		if (MODE_STEP_SERVICE_STOP == plan->steps[i].type)
+			services &= ~(plan->steps[i].arg);
+		else if (MODE_STEP_NET_DOWN == plan->steps[i].type)
+			usb0Ip = EINA_FALSE;
+	}
+
+	ret = mode_plan_fill(plan, plan->from, cur, services, usb0Ip, to, forceKernel);
+	__USB_FUNC_EXIT__ ;
+	return ret;
+}
+
+void um_mode_plan_log(UmModePlan *plan)
+{
+	if (!plan) return;
+	int i;
+	USB_LOG("Mode plan %d -> %d: %d steps\n", plan->from, plan->to, plan->numSteps);
+	for (i = 0 ; i < plan->numSteps ; i++) {
+		USB_LOG("  [%d] %s(%d) deps: 0x%x%s\n", i, stepNames[plan->steps[i].type],
+					plan->steps[i].arg, plan->steps[i].deps,
+					plan->steps[i].critical ? " critical" : "");
+	}
+}
+
+/* Times are in ms from the start of the plan */
+void um_mode_plan_log_timing(UmModePlan *plan)
+{
+	if (!plan) return;
+	UmModeStep *step;
+	double sum = 0;
+	int i;
+
+	for (i = 0 ; i < plan->numSteps ; i++) {
+		step = &(plan->steps[i]);
+		if (MODE_STEP_DONE != step->state) {
+			USB_LOG("  [%d] %s(%d): not run\n", i, stepNames[step->type], step->arg);
+			continue;
+		}
+		USB_LOG("  [%d] %s(%d): %8.3f - %8.3f nice %d policy %d%s\n", i, stepNames[step->type],
+					step->arg, (step->begin - plan->begin) * 1000, (step->end - plan->begin) * 1000,
+					step->nice, step->policy, step->timedOut ? " (deadline missed)" : "");
+		sum += step->end - step->begin;
+	}
+	USB_LOG("Mode plan %d -> %d took %.3f ms (%.3f ms in steps) at nice %d\n", plan->from, plan->to,
+					(plan->end - plan->begin) * 1000, sum * 1000, plan->nice);
+	/* IPC requests and uevents wait at most this long for the plan.
+	 * Run blocking, the plan would hold the main loop for all of its time */
+	USB_LOG("Mode plan %d -> %d held the main loop for up to %.3f ms, %.3f ms if run blocking\n",
+					plan->from, plan->to, plan->maxSlice * 1000, (plan->end - plan->begin) * 1000);
+}
@@ -86,6 +86,40 @@ int um_heynoti_remove(int fd, char *noti, void (*cb)(void *))
 	return 0;
 }
 
+#ifdef USB_SERVER_RESIDENT
+/* Only the state of the last connection is dropped.
+ * Sockets, subscriptions, the driver version and the caches are kept */
+static void reset_usb_connection(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__;
+	if (!ad) return;
+	int ret = -1;
+
+	FREE(tempAppId);
+	ret = um_vconf_get(ad, VCONF_USB_SEL_MODE, &(ad->usbSelMode));
+	if (0 != ret) {
+		USB_LOG("FAIL: vconf_get_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT)\n");
+		ad->usbSelMode = SETTING_USB_DEFAULT_MODE;
+	}
+	__USB_FUNC_EXIT__;
+}
+#endif
+
+#ifndef USB_SERVER_RESIDENT
+static void usb_server_quit_cb(void *data)
+{
+	__USB_FUNC_ENTER__;
+	UmMainData *ad = (UmMainData *)data;
+	int ret = -1;
+
+	/* The vconf cache is used up to here. It is reported when it is released */
+	ret = um_usb_server_release_handler(ad);
+	if (ret < 0) USB_LOG("FAIL: um_usb_server_release_handler(ad)\n");
+	ecore_main_loop_quit();
+	__USB_FUNC_EXIT__;
+}
+#endif
+
 static int terminate_usb_connection(UmMainData *ad)
 {
 	__USB_FUNC_ENTER__;
@@ -93,43 +127,70 @@ static int terminate_usb_connection(UmMainData *ad)
 	int ret = -1;
 	int status = -1;
 
-	ret = um_usb_server_release_handler(ad);
-	if (ret < 0) USB_LOG("FAIL: um_usb_server_release_handler(ad)\n");
+	um_udc_watch_stop(ad);
 
+	/* Committed once the accessory status is also updated */
+	um_vconf_batch_begin(ad);
 	ret = disconnectUsb(ad);
 	if(0 != ret) USB_LOG("FAIL: disconnectUsb(ad)");
 
 	/* If USB accessory is removed, the vconf value of accessory status should be updated */
-	ret = vconf_get_int(VCONFKEY_USB_ACCESSORY_STATUS, &status);
+	ret = um_vconf_get(ad, VCONF_ACC_STATUS, &status);
 	if (0 == ret && VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED == status) {
-		ret = vconf_set_int(VCONFKEY_USB_ACCESSORY_STATUS,
+		ret = um_vconf_set(ad, VCONF_ACC_STATUS,
 						VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
 		if(0 != ret) USB_LOG("FAIL: vconf_set_int(VCONFKEY_USB_ACCESSORY_STATUS");
 		ret = disconnectAccessory(ad);
 		if(0 != ret) USB_LOG("FAIL: disconnectAccessory(ad)\n");
 	}
-	ecore_main_loop_quit();
+	ret = um_vconf_batch_commit(ad);
+	if (0 != ret) USB_LOG("FAIL: um_vconf_batch_commit(ad)\n");
+
+	/* The descriptors stay in the driver even if usb-server exits */
+	stage_next_mode(ad);
+#ifdef USB_SERVER_RESIDENT
+	um_vconf_cache_report(ad);
+	reset_usb_connection(ad);
+#else
+	/* The clean-up of the mode runs from the main loop */
+	if (0 != mode_transition_wait(usb_server_quit_cb, ad))
+		usb_server_quit_cb(ad);
+#endif
 	__USB_FUNC_EXIT__;
 	return 0;
 }
 
-static void usb_chgdet_cb(keynode_t *in_key, void *data)
+static void usb_status_apply(UmMainData *ad)
 {
 	__USB_FUNC_ENTER__;
-	if (!data) return;
-	UmMainData *ad = (UmMainData *)data;
+	if (!ad) return;
 	int status = -1;
 	int ret = -1;
-	status = check_usb_connection();
+	status = um_usb_status(ad);
+	if (status == ad->usbStatusApplied) {
+		/* The cable flapped but ended where it was */
+		ad->usbStatusAbsorbed++;
+		USB_LOG("USB status %d is not changed (events: %u, absorbed: %u)\n",
+					status, ad->usbStatusEvents, ad->usbStatusAbsorbed);
+		return;
+	}
+	ad->usbStatusApplied = status;
+	USB_LOG("USB status %d (events: %u, absorbed: %u)\n",
+					status, ad->usbStatusEvents, ad->usbStatusAbsorbed);
+
 	switch(status) {
 	case VCONFKEY_SYSMAN_USB_DISCONNECTED:
 		ret = terminate_usb_connection(ad);
 		um_retm_if(0 != ret, "FAIL: terminate_usb_connection(ad)");
 		break;
 	case VCONFKEY_SYSMAN_USB_AVAILABLE:
+		/* Without a status change, usb-server is started because of the cable
+		 * and the time of the plug is not known */
+		ad->enumReport.start = (ad->usbStatusEventTime > 0) ? ad->usbStatusEventTime : -1;
 		ret = connectUsb(ad);
 		um_retm_if(0 != ret, "FAIL: connectUsb(ad)");
-		if (VCONFKEY_SYSMAN_USB_AVAILABLE != check_usb_connection()) {
+		if (VCONFKEY_SYSMAN_USB_AVAILABLE != um_usb_status(ad)) {
+			ad->usbStatusApplied = VCONFKEY_SYSMAN_USB_DISCONNECTED;
 			ret = terminate_usb_connection(ad);
 			um_retm_if(0 != ret, "FAIL: terminate_usb_connection(ad)\n");
 		}
@@ -140,21 +201,57 @@ static void usb_chgdet_cb(keynode_t *in_key, void *data)
 	__USB_FUNC_EXIT__;
 }
 
-static void acc_chgdet_cb(void *data)
+static Eina_Bool usb_status_settled_cb(void *data)
+{
+	__USB_FUNC_ENTER__;
+	UmMainData *ad = (UmMainData *)data;
+	if (!ad) return ECORE_CALLBACK_CANCEL;
+	ad->usbStatusTimer = NULL;
+	usb_status_apply(ad);
+	__USB_FUNC_EXIT__;
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/* Cable status changes are handled once the status has been stable for
+ * USB_STATUS_SETTLE_MS, so a burst of flaps is handled as its final state */
+static void usb_chgdet_cb(keynode_t *in_key, void *data)
 {
 	__USB_FUNC_ENTER__;
 	if (!data) return;
 	UmMainData *ad = (UmMainData *)data;
-	static int status;
+
+	um_vconf_cache_notify(ad, VCONF_USB_STATUS, in_key);
+	ad->usbStatusEvents++;
+	ad->usbStatusEventTime = ecore_time_get();	/* Monotonic, like every other stamp */
+	if (ad->usbStatusTimer) {
+		ad->usbStatusAbsorbed++;
+		ecore_timer_reset(ad->usbStatusTimer);
+		__USB_FUNC_EXIT__;
+		return;
+	}
+
+	ad->usbStatusTimer = ecore_timer_add((double)USB_STATUS_SETTLE_MS / 1000,
+						usb_status_settled_cb, ad);
+	if (!ad->usbStatusTimer) {
+		USB_LOG("FAIL: ecore_timer_add(). The USB status is handled now\n");
+		usb_status_apply(ad);
+	}
+	__USB_FUNC_EXIT__;
+}
+
+/* status is VCONFKEY_SYSMAN_USB_AVAILABLE if the accessory is attached */
+static void acc_status_apply(UmMainData *ad, int status)
+{
+	__USB_FUNC_ENTER__;
+	if (!ad) return;
 	int ret;
-	status = check_usb_connection();
 	switch(status) {
 	case VCONFKEY_SYSMAN_USB_DISCONNECTED:
 		USB_LOG("ACC_DISCONNECTED %d", status);
-		ret = vconf_get_int(VCONFKEY_USB_ACCESSORY_STATUS, &status);
+		ret = um_vconf_get(ad, VCONF_ACC_STATUS, &status);
 		um_retm_if(0 != ret, "FAIL: vconf_get_int(VCONFKEY_USB_SERVER_ACCESSORY_STATUS_INT)\n");
 		if (VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED == status) {
-			ret = vconf_set_int(VCONFKEY_USB_ACCESSORY_STATUS,
+			ret = um_vconf_set(ad, VCONF_ACC_STATUS,
 						VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED);
 			um_retm_if(ret != 0, "FAIL: vconf_set_int(VCONFKEY_USB_ACCESSORY_STATUS)");
 			ret = disconnectAccessory(ad);
@@ -163,10 +260,10 @@ static void acc_chgdet_cb(void *data)
 		break;
 	case VCONFKEY_SYSMAN_USB_AVAILABLE:
 		USB_LOG("ACC_CONNECTED %d", status);
-		ret = vconf_get_int(VCONFKEY_USB_ACCESSORY_STATUS, &status);
+		ret = um_vconf_get(ad, VCONF_ACC_STATUS, &status);
 		um_retm_if(0 != ret, "FAIL: vconf_get_int(VCONFKEY_USB_SERVER_ACCESSORY_STATUS_INT)\n");
 		if (VCONFKEY_USB_ACCESSORY_STATUS_DISCONNECTED == status) {
-			ret = vconf_set_int(VCONFKEY_USB_ACCESSORY_STATUS,
+			ret = um_vconf_set(ad, VCONF_ACC_STATUS,
 						VCONFKEY_USB_ACCESSORY_STATUS_CONNECTED);
 			um_retm_if(ret != 0, "FAIL: vconf_set_int(VCONFKEY_USB_ACCESSORY_STATUS, CONNECTED)");
 			ret = connectAccessory(ad);
@@ -179,6 +276,28 @@ static void acc_chgdet_cb(void *data)
 	__USB_FUNC_EXIT__;
 }
 
+static void acc_chgdet_cb(void *data)
+{
+	__USB_FUNC_ENTER__;
+	if (!data) return;
+	UmMainData *ad = (UmMainData *)data;
+	acc_status_apply(ad, um_usb_status(ad));
+	__USB_FUNC_EXIT__;
+}
+
+/* The same event can still come through heynoti from the udev rule.
+ * It is ignored then since the accessory status is already set */
+static void acc_uevent_cb(UmMainData *ad, UEVENT_ACCESSORY event)
+{
+	__USB_FUNC_ENTER__;
+	if (!ad) return;
+	if (UEVENT_ACCESSORY_START == event)
+		acc_status_apply(ad, VCONFKEY_SYSMAN_USB_AVAILABLE);
+	else
+		acc_status_apply(ad, VCONFKEY_SYSMAN_USB_DISCONNECTED);
+	__USB_FUNC_EXIT__;
+}
+
 int um_vconf_key_notify(UmMainData *ad)
 {
 	__USB_FUNC_ENTER__;
@@ -194,6 +313,12 @@ int um_vconf_key_notify(UmMainData *ad)
 	if (0 != ret) {
 		USB_LOG("ERROR: vconf_notify_key_changed(VCONFKEY_MOBILE_HOTSPOT_MODE)");
 	}
+	ret = um_event_subscribe(UM_EVENT_MODE_REQUEST, usb_mode_request_cb);
+	um_retvm_if(0 != ret, -1, "FAIL: um_event_subscribe(UM_EVENT_MODE_REQUEST)");
+
+	/* After the subscriptions above, which keep the cached values of their keys */
+	ret = um_vconf_cache_init(ad);
+	um_retvm_if(0 != ret, -1, "FAIL: um_vconf_cache_init(ad)");
 
 	__USB_FUNC_EXIT__;
 	return 0;
@@ -206,7 +331,7 @@ int um_value_init(UmMainData *ad)
 	int ret = -1;
 
 	/* USB Connection Manager */
-	ret = vconf_get_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT, &(ad->usbSelMode));
+	ret = um_vconf_get(ad, VCONF_USB_SEL_MODE, &(ad->usbSelMode));
 	um_retvm_if (0 != ret, -1, "FAIL: vconf_get_int(VCONFKEY_SETAPPL_USB_SEL_MODE_INT)\n");
 	umAccInfoInit(ad);
 
@@ -247,140 +372,202 @@ int noti_selected_btn(UmMainData *ad, int input)
 	return 0;
 }
 
-Eina_Bool answer_to_ipc(void *data, Ecore_Fd_Handler *fd_handler)
+/* Handles a request of the text or binary IPC protocol */
+static int answer_to_ipc(UmMainData *ad, int input, char *appId, UmAccInfoBlob **blob)
 {
 	__USB_FUNC_ENTER__;
-	if (!data) return ECORE_CALLBACK_CANCEL;
-	UmMainData *ad = (UmMainData *)data;
-	char str[SOCK_STR_LEN];
-	int fd, input, output, t, n;
+	if (!ad || !appId || !blob) return IPC_ERROR;
 	int ret = -1;
-	struct sockaddr_un remote;
-
-	if (ecore_main_fd_handler_active_get(fd_handler, ECORE_FD_READ) == EINA_FALSE)
-		return ECORE_CALLBACK_CANCEL;
-	fd = ecore_main_fd_handler_fd_get(fd_handler);
-
-	t = sizeof(remote);
-	if ((ad->server_sock_remote
-			= accept(ad->server_sock_local, (struct sockaddr *)&remote, &t)) == -1) {
-		perror("accept");
-		USB_LOG("FAIL: accept(ad->server_sock_local, (struct sockaddr *)&remote, &t)\n");
-		return ;
-	}
-	n = recv(ad->server_sock_remote, str, SOCK_STR_LEN, 0);
-	if (n <= 0) {
-		snprintf(str, SOCK_STR_LEN, "ERROR");
-	} else {
-		USB_LOG("[SERVER] Received value: %s", str);
-		char *appId = str;
-		if (str) {
-			while (*appId++) {
-				if('|' == *appId) {
-					*appId = '\0';
-					appId++;
-					break;
-				}
-				USB_LOG("#");
-			}
-		}
-		USB_LOG("input: %s, appId: %s\n", str, appId);
-
-		input = atoi(str);
-		switch(input) {
-		case LAUNCH_APP_FOR_ACC:
-			ret = grantAccessoryPermission(ad, appId);
-			if (0 != ret) {
-				USB_LOG("FAIL: grant_permission_to_app(appId)");
-				snprintf(str, SOCK_STR_LEN, "%d", IPC_ERROR);
-				break;
-			}
-			ret = launch_acc_app(ad->permittedPkgForAcc);
-			if (0 != ret) {
-				USB_LOG("FAIL: launch_app(appId)");
-				snprintf(str, SOCK_STR_LEN, "%d", IPC_ERROR);
-				break;
-			}
-			snprintf(str, SOCK_STR_LEN, "%d", IPC_SUCCESS);
-			break;
-		case REQ_ACC_PERMISSION:
-			tempAppId = strdup(appId);
-			USB_LOG("tempAppId: %s\n", tempAppId);
-			load_system_popup(ad, REQ_ACC_PERM_POPUP);
-			snprintf(str, SOCK_STR_LEN, "%d", IPC_SUCCESS);
-			break;
-		case HAS_ACC_PERMISSION:
-			if (EINA_TRUE == hasAccPermission(ad, appId)) {
-				snprintf(str, SOCK_STR_LEN, "%d", IPC_SUCCESS);
-			} else {
-				snprintf(str, SOCK_STR_LEN, "%d", IPC_FAIL);
-			}
-			break;
-		case REQ_ACC_PERM_NOTI_YES_BTN:
-		case REQ_ACC_PERM_NOTI_NO_BTN:
-			snprintf(str, SOCK_STR_LEN, "%d", IPC_SUCCESS);
-			ret = noti_selected_btn(ad, input);
-			if (ret < 0) USB_LOG("FAIL: noti_selected_btn(input)\n");
-			break;
-		case GET_ACC_INFO:
-			snprintf(str, SOCK_STR_LEN, "%s|%s|%s|%s|%s|%s",
-							ad->usbAcc->manufacturer,
-							ad->usbAcc->model,
-							ad->usbAcc->description,
-							ad->usbAcc->version,
-							ad->usbAcc->uri,
-							ad->usbAcc->serial);
-			break;
-		case ERROR_POPUP_OK_BTN:
-			usb_connection_selected_btn(ad, input);
-			snprintf(str, SOCK_STR_LEN, "%d", IPC_SUCCESS);
-			break;
-		case IS_EMUL_BIN:
-			if (is_emul_bin()) {
-				snprintf(str, SOCK_STR_LEN, "%d", IPC_SUCCESS);
-			} else {
-				snprintf(str, SOCK_STR_LEN, "%d", IPC_FAIL);
-			}
+	int result = IPC_ERROR;
+
+	USB_LOG("input: %d, appId: %s\n", input, appId);
+
+	switch(input) {
+	case LAUNCH_APP_FOR_ACC:
+		ret = grantAccessoryPermission(ad, appId);
+		if (0 != ret) {
+			USB_LOG("FAIL: grant_permission_to_app(appId)");
+			result = IPC_ERROR;
 			break;
-		default:
-			snprintf(str, SOCK_STR_LEN, "%d", IPC_ERROR);
+		}
+		ret = launch_acc_app(ad->permittedPkgForAcc);
+		if (0 != ret) {
+			USB_LOG("FAIL: launch_app(appId)");
+			result = IPC_ERROR;
 			break;
 		}
+		result = IPC_SUCCESS;
+		break;
+	case REQ_ACC_PERMISSION:
+		tempAppId = strdup(appId);
+		USB_LOG("tempAppId: %s\n", tempAppId);
+		load_system_popup(ad, REQ_ACC_PERM_POPUP);
+		result = IPC_SUCCESS;
+		break;
+	case HAS_ACC_PERMISSION:
+		if (EINA_TRUE == hasAccPermission(ad, appId)) {
+			result = IPC_SUCCESS;
+		} else {
+			result = IPC_FAIL;
+		}
+		break;
+	case REQ_ACC_PERM_NOTI_YES_BTN:
+	case REQ_ACC_PERM_NOTI_NO_BTN:
+		result = IPC_SUCCESS;
+		ret = noti_selected_btn(ad, input);
+		if (ret < 0) USB_LOG("FAIL: noti_selected_btn(input)\n");
+		break;
+	case GET_ACC_INFO:
+		/* Serialized when the accessory was connected */
+		*blob = accInfoBlobRef(ad->accInfo);
+		result = (*blob) ? IPC_SUCCESS : IPC_ERROR;
+		break;
+	case ERROR_POPUP_OK_BTN:
+		usb_connection_selected_btn(ad, input);
+		result = IPC_SUCCESS;
+		break;
+	case IS_EMUL_BIN:
+		if (is_emul_bin()) {
+			result = IPC_SUCCESS;
+		} else {
+			result = IPC_FAIL;
+		}
+		break;
+	case IS_IN_MODE_CHANGE:
+		/* Answered while the mode change runs */
+		if (EINA_TRUE == usb_mode_changing(ad)) {
+			result = IPC_SUCCESS;
+		} else {
+			result = IPC_FAIL;
+		}
+		break;
+	default:
+		result = IPC_ERROR;
+		break;
 	}
-	USB_LOG("str: %s", str);
+	__USB_FUNC_EXIT__;
+	return result;
+}
 
-	if(send(ad->server_sock_remote, str, strlen(str)+1, 0) < 0) {
-		USB_LOG("FAIL: end(ad->server_sock_remote, str, strlen(str)+1, 0)\n");
+static const char *startupPhaseNames[MAX_NUM_STARTUP_PHASE] = {
+	"VALUE_INIT",
+	"PROC_INIT",
+	"DRIVER_CHECK",
+	"VCONF_NOTIFY",
+	"USB_STATUS",
+	"IPC_SERVER",
+	"UEVENT",
+	"HEYNOTI"
+};
+
+static void startup_phase_begin(UmMainData *ad, STARTUP_PHASE phase)
+{
+	ad->startup.phaseBegin[phase] = ecore_time_get();
+}
+
+static void startup_phase_end(UmMainData *ad, STARTUP_PHASE phase)
+{
+	ad->startup.phaseEnd[phase] = ecore_time_get();
+}
+
+/* Times are in ms. 'at' is from the start of usb_server_main() */
+void um_startup_report(UmMainData *ad)
+{
+	if (!ad) return;
+	UmStartupReport *report = &(ad->startup);
+	double last = report->start;
+	int i;
+
+	USB_LOG("** usb-server startup **\n");
+	for (i = 0 ; i < MAX_NUM_STARTUP_PHASE ; i++) {
+		if (report->phaseEnd[i] <= 0) {
+			USB_LOG("%-13s: not run\n", startupPhaseNames[i]);
+			continue;
+		}
+		USB_LOG("%-13s: at %8.3f, took %8.3f\n", startupPhaseNames[i],
+					(report->phaseBegin[i] - report->start) * 1000,
+					(report->phaseEnd[i] - report->phaseBegin[i]) * 1000);
+		if (report->phaseEnd[i] > last) last = report->phaseEnd[i];
 	}
+	USB_LOG("Total        : %8.3f\n", (last - report->start) * 1000);
+	USB_LOG("************************\n");
+}
+
+/* The IPC listener and the accessory events are not needed to configure the gadget,
+ * so they are set up once the main loop is running */
+static void um_usb_server_lazy_init(void *data)
+{
+	__USB_FUNC_ENTER__;
+	UmMainData *ad = (UmMainData *)data;
+	if (!ad) return;
+	int ret = -1;
+
+	ad->lazyInitJob = NULL;
+
+	startup_phase_begin(ad, STARTUP_PHASE_IPC_SERVER);
+	ret = um_ipc_server_start(ad, answer_to_ipc);
+	startup_phase_end(ad, STARTUP_PHASE_IPC_SERVER);
+	if (0 != ret) USB_LOG("FAIL: um_ipc_server_start()\n");
+
+	startup_phase_begin(ad, STARTUP_PHASE_UEVENT);
+	ret = um_uevent_listener_start(ad, acc_uevent_cb);
+	startup_phase_end(ad, STARTUP_PHASE_UEVENT);
+	if (0 != ret) USB_LOG("FAIL: um_uevent_listener_start(). Accessories are notified by heynoti only\n");
 
+	startup_phase_begin(ad, STARTUP_PHASE_HEYNOTI);
+	ret = um_heynoti_add(&(ad->acc_noti_fd), "device_usb_accessory", acc_chgdet_cb, ad);
+	startup_phase_end(ad, STARTUP_PHASE_HEYNOTI);
+	if (0 != ret) {
+		USB_LOG("FAIL: um_heynoti_add(ad->acc_noti_fd)\n");
+		ad->acc_noti_fd = -1;
+	}
+
+	um_startup_report(ad);
 	__USB_FUNC_EXIT__;
-	return ECORE_CALLBACK_RENEW;
 }
 
 int um_usb_server_init(UmMainData *ad)
 {
 	__USB_FUNC_ENTER__;
 	if(!ad) return -1;
-	um_value_init(ad);
 	int ret = -1;
 
-	ret = check_driver_version(ad);
-	um_retvm_if(0 != ret, -1, "FAIL: check_driver_version(ad)");
+	ad->acc_noti_fd = -1;
+	ad->ueventSock = -1;
+	ad->stagedMode = -1;
+	ad->udcStateFd = -1;
+
+	startup_phase_begin(ad, STARTUP_PHASE_VALUE_INIT);
+	um_value_init(ad);
+	startup_phase_end(ad, STARTUP_PHASE_VALUE_INIT);
 
-	ad->server_sock_local = ipc_request_server_init();
-	um_retvm_if(0 > ad->server_sock_local, -1, "FAIL: ipc_request_server_init()\n");
+	startup_phase_begin(ad, STARTUP_PHASE_PROC_INIT);
+	ret = um_proc_init();
+	startup_phase_end(ad, STARTUP_PHASE_PROC_INIT);
+	if (0 != ret) USB_LOG("FAIL: um_proc_init(). Commands will block the main loop\n");
 
-	ad->ipcRequestServerFdHandler = ecore_main_fd_handler_add(ad->server_sock_local,
-							ECORE_FD_READ, answer_to_ipc, ad, NULL, NULL);
-	um_retvm_if(NULL == ad->ipcRequestServerFdHandler, -1, "FAIL: ecore_main_fd_handler_add()");
+	startup_phase_begin(ad, STARTUP_PHASE_DRIVER_CHECK);
+	ret = check_driver_version(ad);
+	startup_phase_end(ad, STARTUP_PHASE_DRIVER_CHECK);
+	um_retvm_if(0 != ret, -1, "FAIL: check_driver_version(ad)");
 
+	/* Subscribed before the status is read, so that no change is lost */
+	startup_phase_begin(ad, STARTUP_PHASE_VCONF_NOTIFY);
 	ret = um_vconf_key_notify(ad);
+	startup_phase_end(ad, STARTUP_PHASE_VCONF_NOTIFY);
 	um_retvm_if(0 != ret, -1, "FAIL: um_vconf_key_notify(ad)");
 
-	ret = um_heynoti_add(&(ad->acc_noti_fd), "device_usb_accessory", acc_chgdet_cb, ad);
-	um_retvm_if(0 != ret, -1, "FAIL: um_heynoti_add(ad->acc_noti_fd)");
+	ad->lazyInitJob = ecore_job_add(um_usb_server_lazy_init, ad);
+	if (!ad->lazyInitJob) {
+		USB_LOG("FAIL: ecore_job_add(). Initialize everything now\n");
+		um_usb_server_lazy_init(ad);
+	}
 
-	usb_chgdet_cb(NULL, ad);
+	/* The status at start is handled without waiting */
+	startup_phase_begin(ad, STARTUP_PHASE_USB_STATUS);
+	ad->usbStatusApplied = -1;
+	usb_status_apply(ad);
+	startup_phase_end(ad, STARTUP_PHASE_USB_STATUS);
 
 	__USB_FUNC_EXIT__;
 	return 0;
@@ -391,13 +578,19 @@ int um_usb_server_release_handler(UmMainData *ad)
 	__USB_FUNC_ENTER__;
 	int ret = -1;
 
-	if (ad->ipcRequestServerFdHandler != NULL) {
-		ecore_main_fd_handler_del(ad->ipcRequestServerFdHandler);
-		ad->ipcRequestServerFdHandler == NULL;
+	if (ad->lazyInitJob) {
+		ecore_job_del(ad->lazyInitJob);
+		ad->lazyInitJob = NULL;
+		um_startup_report(ad);
 	}
+	um_ipc_server_stop(ad);
+	um_uevent_listener_stop(ad);
 
-	ipc_request_server_close(ad);
-
+	if (ad->usbStatusTimer) {
+		ecore_timer_del(ad->usbStatusTimer);
+		ad->usbStatusTimer = NULL;
+	}
+	um_udc_watch_stop(ad);
 	ret = vconf_ignore_key_changed(VCONFKEY_SYSMAN_USB_STATUS, usb_chgdet_cb);
 	if (0 != ret) USB_LOG("FAIL: vconf_notify_key_changed(VCONFKEY_SYSMAN_USB_STATUS)");
 
@@ -406,9 +599,14 @@ int um_usb_server_release_handler(UmMainData *ad)
 
 	ret = vconf_ignore_key_changed(VCONFKEY_MOBILE_HOTSPOT_MODE, change_hotspot_status_cb);
 	if (0 != ret) USB_LOG("ERROR: vconf_notify_key_changed(VCONFKEY_MOBILE_HOTSPOT_MODE)");
+	um_event_bus_clear(ad);
+	um_vconf_cache_deinit(ad);
 
-	ret = um_heynoti_remove(ad->acc_noti_fd, "device_usb_accessory", acc_chgdet_cb);
-	if (0 != ret) USB_LOG("FAIL: um_heynoti_remove(ad->acc_noti_fd)\n");
+	if (ad->acc_noti_fd >= 0) {
+		ret = um_heynoti_remove(ad->acc_noti_fd, "device_usb_accessory", acc_chgdet_cb);
+		if (0 != ret) USB_LOG("FAIL: um_heynoti_remove(ad->acc_noti_fd)\n");
+		ad->acc_noti_fd = -1;
+	}
 
 	__USB_FUNC_EXIT__;
 	return 0;
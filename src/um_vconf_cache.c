@@ -0,0 +1,287 @@
+/*
+ * Usb Server
+ *
+ * Copyright (c) 2000 - 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Contact: Taeyoung Kim <ty317.kim@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "um_vconf_cache.h"
+
+/* Indexed by VCONF_CACHE_KEY */
+static const char *vconfCacheKeys[MAX_NUM_VCONF_CACHE] = {
+	VCONFKEY_SYSMAN_USB_STATUS,
+	VCONFKEY_SETAPPL_USB_SEL_MODE_INT,
+	VCONFKEY_SETAPPL_USB_MODE_INT,
+	VCONFKEY_MOBILE_HOTSPOT_MODE,
+	VCONFKEY_USB_ACCESSORY_STATUS,
+	VCONFKEY_SETAPPL_USB_IN_MODE_CHANGE
+};
+
+/* Keys whose changes the server handles. Their callbacks call um_vconf_cache_notify() */
+static const Eina_Bool vconfCacheServerNotified[MAX_NUM_VCONF_CACHE] = {
+	EINA_TRUE,		/* usb_chgdet_cb() */
+	EINA_TRUE,		/* change_mode_cb() */
+	EINA_FALSE,
+	EINA_TRUE,		/* change_hotspot_status_cb() */
+	EINA_FALSE,
+	EINA_FALSE
+};
+
+/* vconf_set() on a keylist writes the keys one by one, so a listener can read
+ * a batch half written. The keys which carry the state of the connection are
+ * written last and in this order: whoever they wake up reads the rest of the
+ * batch already written */
+#define NUM_VCONF_CACHE_LAST	2
+static const VCONF_CACHE_KEY vconfCacheLastKeys[NUM_VCONF_CACHE_LAST] = {
+	VCONF_USB_MODE,
+	VCONF_USB_IN_MODE_CHANGE
+};
+
+static Eina_Bool vconf_cache_last_key(int key)
+{
+	int i;
+	for (i = 0 ; i < NUM_VCONF_CACHE_LAST ; i++) {
+		if (key == vconfCacheLastKeys[i]) return EINA_TRUE;
+	}
+	return EINA_FALSE;
+}
+
+static int vconf_cache_fill(UmMainData *ad, VCONF_CACHE_KEY key)
+{
+	UmVconfCache *cache = &(ad->vconfCache);
+	int ret = -1;
+
+	cache->fills++;
+	ret = vconf_get_int(vconfCacheKeys[key], &(cache->value[key]));
+	um_retvm_if(0 != ret, -1, "FAIL: vconf_get_int(%s)\n", vconfCacheKeys[key]);
+	cache->valid[key] = EINA_TRUE;
+	return 0;
+}
+
+static void vconf_cache_changed_cb(keynode_t *in_key, void *data)
+{
+	UmMainData *ad = (UmMainData *)data;
+	const char *name = NULL;
+	int key;
+	if (!ad || !in_key) return;
+
+	name = vconf_keynode_get_name(in_key);
+	if (!name) return;
+	for (key = 0 ; key < MAX_NUM_VCONF_CACHE ; key++) {
+		if (!strcmp(name, vconfCacheKeys[key])) {
+			um_vconf_cache_notify(ad, key, in_key);
+			return;
+		}
+	}
+}
+
+int um_vconf_cache_init(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return -1;
+	UmVconfCache *cache = &(ad->vconfCache);
+	int key;
+	int ret = -1;
+
+	memset(cache, 0x0, sizeof(UmVconfCache));
+
+	/* Subscribed before the values are read, so that no change is lost */
+	for (key = 0 ; key < MAX_NUM_VCONF_CACHE ; key++) {
+		if (EINA_TRUE == vconfCacheServerNotified[key]) continue;
+		ret = vconf_notify_key_changed(vconfCacheKeys[key], vconf_cache_changed_cb, ad);
+		if (0 != ret) {
+			/* The key is then read from the backend every time */
+			USB_LOG("FAIL: vconf_notify_key_changed(%s)\n", vconfCacheKeys[key]);
+			continue;
+		}
+		cache->subscribed[key] = EINA_TRUE;
+	}
+	for (key = 0 ; key < MAX_NUM_VCONF_CACHE ; key++) {
+		vconf_cache_fill(ad, key);
+	}
+
+	__USB_FUNC_EXIT__ ;
+	return 0;
+}
+
+void um_vconf_cache_deinit(UmMainData *ad)
+{
+	__USB_FUNC_ENTER__ ;
+	if (!ad) return;
+	UmVconfCache *cache = &(ad->vconfCache);
+	int key;
+
+	um_vconf_cache_report(ad);
+	for (key = 0 ; key < MAX_NUM_VCONF_CACHE ; key++) {
+		if (EINA_TRUE == cache->subscribed[key]
+				&& 0 != vconf_ignore_key_changed(vconfCacheKeys[key], vconf_cache_changed_cb))
+			USB_LOG("FAIL: vconf_ignore_key_changed(%s)\n", vconfCacheKeys[key]);
+		cache->subscribed[key] = EINA_FALSE;
+		cache->valid[key] = EINA_FALSE;
+	}
+	__USB_FUNC_EXIT__ ;
+}
+
+void um_vconf_cache_report(UmMainData *ad)
+{
+	if (!ad) return;
+	UmVconfCache *cache = &(ad->vconfCache);
+	USB_LOG("vconf cache: %u reads avoided, %u backend reads, %u notified, %u written in %u batches, %u echoes\n",
+					cache->hits, cache->fills, cache->updates, cache->writes, cache->batches, cache->echoes);
+}
+
+Eina_Bool um_vconf_cache_notify(UmMainData *ad, VCONF_CACHE_KEY key, keynode_t *in_key)
+{
+	if (!ad || key < 0 || key >= MAX_NUM_VCONF_CACHE) return EINA_FALSE;
+	UmVconfCache *cache = &(ad->vconfCache);
+	Eina_Bool echo = cache->echo[key];
+	int value;
+
+	cache->echo[key] = EINA_FALSE;
+	if (!in_key || VCONF_TYPE_INT != vconf_keynode_get_type(in_key)) {
+		cache->valid[key] = EINA_FALSE;
+		return EINA_FALSE;
+	}
+	value = vconf_keynode_get_int(in_key);
+
+	/* Notifications can be merged, so a different value means another writer */
+	if (EINA_TRUE == echo && EINA_TRUE == cache->valid[key] && value == cache->value[key]) {
+		cache->echoes++;
+		return EINA_TRUE;
+	}
+	cache->value[key] = value;
+	cache->valid[key] = EINA_TRUE;
+	cache->updates++;
+	return EINA_FALSE;
+}
+
+int um_vconf_get(UmMainData *ad, VCONF_CACHE_KEY key, int *value)
+{
+	if (!ad || !value || key < 0 || key >= MAX_NUM_VCONF_CACHE) return -1;
+	UmVconfCache *cache = &(ad->vconfCache);
+
+	/* Without notifications the value can go stale, so it is always read */
+	if (EINA_FALSE == vconfCacheServerNotified[key] && EINA_FALSE == cache->subscribed[key])
+		cache->valid[key] = EINA_FALSE;
+
+	if (EINA_TRUE == cache->valid[key]) {
+		cache->hits++;
+	} else if (0 != vconf_cache_fill(ad, key)) {
+		return -1;
+	}
+	*value = cache->value[key];
+	return 0;
+}
+
+int um_vconf_set(UmMainData *ad, VCONF_CACHE_KEY key, int value)
+{
+	if (!ad || key < 0 || key >= MAX_NUM_VCONF_CACHE) return -1;
+	UmVconfCache *cache = &(ad->vconfCache);
+	int ret = -1;
+
+	if (cache->batchDepth > 0) {
+		cache->value[key] = value;
+		cache->valid[key] = EINA_TRUE;
+		cache->pending[key] = EINA_TRUE;
+		return 0;
+	}
+
+	/* Set first, the notification can come before vconf_set_int() returns */
+	cache->value[key] = value;
+	cache->valid[key] = EINA_TRUE;
+	cache->echo[key] = vconfCacheServerNotified[key];
+	ret = vconf_set_int(vconfCacheKeys[key], value);
+	if (0 != ret) {
+		cache->valid[key] = EINA_FALSE;
+		cache->echo[key] = EINA_FALSE;
+		return ret;
+	}
+	cache->writes++;
+	return 0;
+}
+
+void um_vconf_batch_begin(UmMainData *ad)
+{
+	if (!ad) return;
+	ad->vconfCache.batchDepth++;
+}
+
+int um_vconf_batch_commit(UmMainData *ad)
+{
+	if (!ad) return -1;
+	UmVconfCache *cache = &(ad->vconfCache);
+	keylist_t *kl = NULL;
+	int key;
+	int i;
+	int num = 0;
+	int ret = -1;
+
+	um_retvm_if(cache->batchDepth <= 0, -1, "No vconf batch to commit\n");
+	if (--cache->batchDepth > 0) return 0;
+
+	kl = vconf_keylist_new();
+	if (kl) {
+		for (key = 0 ; key < MAX_NUM_VCONF_CACHE ; key++) {
+			if (EINA_FALSE == cache->pending[key] || EINA_TRUE == vconf_cache_last_key(key))
+				continue;
+			if (0 != vconf_keylist_add_int(kl, vconfCacheKeys[key], cache->value[key])) {
+				USB_LOG("FAIL: vconf_keylist_add_int(%s)\n", vconfCacheKeys[key]);
+				break;
+			}
+			cache->echo[key] = vconfCacheServerNotified[key];
+			num++;
+		}
+		/* Nothing is written if the keylist cannot be built */
+		if (key == MAX_NUM_VCONF_CACHE)
+			ret = (num > 0) ? vconf_set(kl) : 0;
+		vconf_keylist_free(kl);
+	} else {
+		USB_LOG("FAIL: vconf_keylist_new()\n");
+	}
+
+	for (i = 0 ; i < NUM_VCONF_CACHE_LAST && 0 == ret ; i++) {
+		key = vconfCacheLastKeys[i];
+		if (EINA_FALSE == cache->pending[key]) continue;
+		cache->echo[key] = vconfCacheServerNotified[key];
+		ret = vconf_set_int(vconfCacheKeys[key], cache->value[key]);
+		if (0 != ret) USB_LOG("FAIL: vconf_set_int(%s)\n", vconfCacheKeys[key]);
+		num++;
+	}
+
+	for (key = 0 ; key < MAX_NUM_VCONF_CACHE ; key++) {
+		if (EINA_FALSE == cache->pending[key]) continue;
+		cache->pending[key] = EINA_FALSE;
+		if (0 != ret) {
+			cache->valid[key] = EINA_FALSE;
+			cache->echo[key] = EINA_FALSE;
+		}
+	}
+	um_retvm_if(0 != ret, -1, "FAIL: vconf_set(%d keys)\n", num);
+	if (num > 0) {
+		cache->writes += num;
+		cache->batches++;
+	}
+	return 0;
+}
+
+int um_usb_status(UmMainData *ad)
+{
+	int status = -1;
+	um_retvm_if(0 != um_vconf_get(ad, VCONF_USB_STATUS, &status), -1,
+					"FAIL: um_vconf_get(VCONF_USB_STATUS)\n");
+	return status;
+}